@@ -3,6 +3,9 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <memory>
+#include <span>
+#include <unordered_map>
 #include <zstd.h>
 
 std::wstring StringToWString(const std::string& s);
@@ -11,18 +14,218 @@ std::string WStringToString(const std::wstring& s);
 namespace acf
 {
   constexpr uint32_t ACF_MAGIC = 0x39464341;
-  constexpr uint32_t ACF_VERSION = 0x10000900;
+  constexpr uint32_t ACF_VERSION = 0x10001000;
+
+  // Size of a central directory record in archives written before v1.0,
+  // which did not store ACFHeader::entrySize.
+  constexpr uint16_t ACF_ENTRY_SIZE_V09 = 36;
+
+  // Bits of ACFHeader::flags.
+  constexpr uint16_t ACF_FLAG_BASE = 0x0001;       // Delta archive: an ACFBaseRecord follows the header
+  constexpr uint16_t ACF_FLAG_REPOSITORY = 0x0002; // Manifest: an ACFRepositoryRecord follows the header
+  // Central directory ahead of the file data, its size in the uint64 before it;
+  // without the flag it runs from centralDirOffset to the end of the archive.
+  constexpr uint16_t ACF_FLAG_FRONT_INDEX = 0x0004;
+
+  // Attribute bits stored in ACFEntryData::fileattribute (Win32 FILE_ATTRIBUTE_* values).
+  constexpr uint8_t ATTR_READONLY = 0x01;
+  constexpr uint8_t ATTR_HIDDEN = 0x02;
+  constexpr uint8_t ATTR_SYSTEM = 0x04;
+  constexpr uint8_t ATTR_DIRECTORY = 0x10;
+  constexpr uint8_t ATTR_ARCHIVE = 0x20;
 
   // Callback function for progress reporting.
   // Parameters: current file path, progress for the current file (0-1), overall progress (0-1).
   using CallbackFunc = std::function<void(const std::string& currentFile, float currentFileProgress, float generalProgress)>;
 
+  // Order in which Create() stores files. The central directory is always path-sorted.
+  enum class FileOrder: uint8_t
+  {
+    Path = 0,       // Sorted by full path
+    Similarity = 1, // Grouped by extension, then base name, then size
+    MinHash = 2     // Like Similarity, with groups formed by content similarity
+  };
+
+  // Order in which Create() reads input files ahead of compressing them. It
+  // only changes when data is fetched from disk, not the archive written.
+  enum class ReadOrder: uint8_t
+  {
+    Path = 0,   // No read-ahead; each file is read when it is compressed
+    Inode = 1,  // Read ahead by inode number
+    Extent = 2  // Read ahead by first physical extent (FIEMAP), else by inode
+  };
+
+  // How ExtractAll() and Extract() treat files that already exist on disk.
+  enum class ExtractUpdate: uint8_t
+  {
+    Off = 0,      // Every file is decoded and written
+    SizeTime = 1, // Skip files whose size and modification time match the entry
+    Crc = 2       // Skip files whose size and content CRC match; only the
+                  // timestamp and mode are set again where they differ
+  };
+
+  // Compression settings used by Create() and CreateData().
+  struct CompressionProfile
+  {
+    int level = 9;
+    int strategy = 0; // ZSTD_strategy, 0 = chosen by the level
+    // Adaptive mode: the level of subsequent blocks moves between minLevel and
+    // maxLevel so that input throughput meets targetMBps or, when deadlineSeconds
+    // is set, so that the whole job finishes within the deadline. Entries patched
+    // from a base or primed with a prefix keep one level throughout.
+    bool adaptive = false;
+    int minLevel = 1;
+    int maxLevel = 19;
+    double targetMBps = 0.0;
+    double deadlineSeconds = 0.0;
+    // Long-range mode: files of at least longRangeMinSize bytes are compressed with
+    // long-distance matching and a window sized to the file (2^27 up to 2^maxWindowLog).
+    bool longRange = false;
+    uint64_t longRangeMinSize = 64ull << 20;
+    int maxWindowLog = 31;
+    // Inputs that already are valid zstd frames are stored verbatim instead of recompressed.
+    bool zstdPassthrough = true;
+    // Reversible pre-filters (x86 branch conversion, byte delta, transposition)
+    // chosen per file by content sniffing.
+    bool filters = true;
+    // With a similarity order the first file of each group (up to 8 MiB) primes
+    // the zstd window of the others, which then depend on it for extraction.
+    FileOrder order = FileOrder::Path;
+    // With a read order other than Path, a background thread reads the next
+    // files (up to readAheadBytes) in that order into the page cache, which
+    // turns a seek per file into near-sequential reads on rotational disks.
+    ReadOrder readOrder = ReadOrder::Path;
+    uint64_t readAheadBytes = 256ull << 20;
+    // Files whose archive path matches one of these patterns ("*.ktx2",
+    // "models/**") are stored uncompressed at a dataOffset that is a multiple
+    // of alignment (a power of two, e.g. 4 KiB or 2 MiB), so that
+    // ArchiveReader::MappedData() can hand out their bytes in place.
+    std::vector<std::string> storeAligned;
+    uint32_t alignment = 4096;
+    // Archive paths stored first, in this order and next to each other, ahead
+    // of all other files (e.g. a startup access profile, see
+    // ArchiveReader::AccessProfile()). Paths not in the archive are ignored.
+    std::vector<std::string> layoutProfile;
+    // Walk filter of Create() and Estimate(), applied as directories are
+    // walked, so an excluded directory is never descended into. Patterns are
+    // matched like storeAligned against the path relative to the walked input
+    // directory ("node_modules", "build/*.o"); a trailing '/' limits one to
+    // directories, a leading '/' to the input's top level. Inputs named
+    // directly are only checked against exclude. With include patterns, a
+    // file found by the walk is stored only if one of them matches.
+    std::vector<std::string> include;
+    std::vector<std::string> exclude;
+    // Name of ignore files honoured during the walk (".acfignore"), empty for
+    // none. Each line excludes a pattern relative to the file's directory, as
+    // in .gitignore: '#' comments, '!' re-includes, and later lines and files
+    // deeper in the tree win.
+    std::string ignoreFileName;
+    // Write the central directory ahead of the file data (ACF_FLAG_FRONT_INDEX),
+    // so that reading from the start yields the listing and then the first
+    // files, without a seek to the end.
+    bool frontIndex = false;
+  };
+
+  // One measured level/strategy combination of BenchLevels().
+  struct LevelBenchResult
+  {
+    int level = 0;
+    int strategy = 0;
+    double ratio = 0.0; // original size / compressed size
+    double compressMBps = 0.0;
+    double decompressMBps = 0.0;
+    bool pareto = false; // no other result is at least as good on ratio and both speeds
+  };
+
+  struct LevelBenchOptions
+  {
+    std::vector<int> levels = { 1, 3, 5, 7, 9, 12, 15, 19 };
+    std::vector<int> strategies = { 0 };
+    uint64_t sampleBytes = 64ull << 20;
+    unsigned threads = 0; // 0 = hardware concurrency
+  };
+
+  // Compresses a sample of the inputs, stratified by extension and size class,
+  // with every level/strategy combination. Results are sorted by ratio, best first.
+  std::vector<LevelBenchResult> BenchLevels(const std::vector<std::string>& inputPaths,
+                                            const LevelBenchOptions& options);
+
+  // Best-ratio Pareto result that still compresses at minCompressMBps or faster.
+  CompressionProfile RecommendProfile(const std::vector<LevelBenchResult>& results,
+                                      double minCompressMBps);
+
+  // Result of ACFArchiver::Estimate(). Low/high values bound a ~95% confidence interval.
+  struct ArchiveEstimate
+  {
+    uint64_t fileCount = 0;
+    uint64_t dirCount = 0;
+    uint64_t inputBytes = 0;
+    uint64_t sampledBlocks = 0;
+    uint64_t sampledBytes = 0;
+    double archiveBytes = 0, archiveBytesLow = 0, archiveBytesHigh = 0;
+    double cpuSeconds = 0, cpuSecondsLow = 0, cpuSecondsHigh = 0;
+    double wallSeconds = 0, wallSecondsLow = 0, wallSecondsHigh = 0;
+  };
+
+  // Result of CollectRepositoryGarbage().
+  struct RepositoryGCStats
+  {
+    uint64_t archives = 0;       // Manifests still present
+    uint64_t missingArchives = 0; // Listed manifests not found, dropped with force
+    uint64_t liveChunks = 0;
+    uint64_t removedChunks = 0;
+    uint64_t removedBytes = 0;   // Compressed bytes freed
+    uint64_t packsRewritten = 0;
+  };
+
+  // Drops chunks that no manifest listed by the repository references any
+  // more. Manifests are listed by absolute path when written into the
+  // repository or registered. If a listed manifest is not found (moved,
+  // renamed, on an unmounted disk) nothing is removed and the call throws,
+  // unless force drops the missing manifests from the list. Live chunks move
+  // to new packs; readers that loaded the index earlier reload it when a
+  // chunk is no longer where they expect it.
+  RepositoryGCStats CollectRepositoryGarbage(const std::string& repositoryPath, bool force = false);
+  // Lists a manifest of the repository, e.g. under the path it was moved to;
+  // throws unless all chunks it references are present.
+  void RegisterRepositoryManifest(const std::string& repositoryPath, const std::string& archivePath);
+  // Takes a manifest off the list, whether or not it still exists, so that
+  // its chunks are collected once no other manifest references them.
+  void UnregisterRepositoryManifest(const std::string& repositoryPath, const std::string& archivePath);
+
+  namespace detail { class ChunkRepository; }
+
   enum class EntryType: uint8_t
   {
     File = 0,
     Directory = 1
   };
 
+  enum class CompressionMethod: uint8_t
+  {
+    Zstd = 0,
+    // The input file was already zstd; its bytes are stored as-is. originalSize
+    // and crc32 describe the decoded content, compressedSize the stored file.
+    ZstdPassthrough = 1,
+    // Compressed with the same path of the base archive as zstd prefix (patch-from).
+    ZstdPatch = 2,
+    // Content lives in a chunk repository; the entry data is a list of chunk
+    // references (SHA-256 and size of each chunk, in order).
+    ChunkRef = 3,
+    // Content stored as it is, uncompressed; compressedSize equals originalSize.
+    Uncompressed = 4
+  };
+
+  // Pre-filter applied to file content before compression. ACFEntryData::filterParam
+  // holds the delta distance or the record stride.
+  enum class FilterType: uint8_t
+  {
+    None = 0,
+    X86 = 1,       // E8/E9 call/jump targets of x86 and x86-64 code made absolute
+    Delta = 2,     // Each byte minus the byte filterParam positions before it
+    Transpose = 3  // Records of filterParam bytes regrouped by byte position
+  };
+
   #pragma pack(push, 1)
   struct ACFHeader
   {
@@ -31,7 +234,24 @@ namespace acf
     uint64_t centralDirOffset = 0;
     uint64_t entryCount = 0;
     uint32_t centralDirCRC32 = 0;
-    uint32_t reserved = 0;
+    uint16_t entrySize = 0; // sizeof(ACFEntryData) of the writer; 0 means ACF_ENTRY_SIZE_V09
+    uint16_t flags = 0;
+  };
+
+  // Identifies the base of a delta archive; followed by nameLength bytes of
+  // its file name. Extraction looks for it next to the archive.
+  struct ACFBaseRecord
+  {
+    uint32_t centralDirCRC32;
+    uint64_t archiveSize;
+    uint16_t nameLength;
+  };
+
+  // Names the chunk repository of a manifest; followed by pathLength bytes of
+  // its path, relative to the manifest's directory where possible.
+  struct ACFRepositoryRecord
+  {
+    uint16_t pathLength;
   };
 
   struct ACFEntryData
@@ -44,6 +264,13 @@ namespace acf
     uint32_t filedatetime;
     uint8_t fileattribute;
     uint16_t pathLength;
+    // --- v1.0 ---
+    uint32_t unixMode; // POSIX st_mode, 0 when written on Windows
+    uint8_t windowLog; // zstd window of a long-range entry, 0 = default (<= 2^27)
+    CompressionMethod method;
+    FilterType filter;
+    uint8_t filterParam;
+    uint64_t prefixOffset; // dataOffset of the entry whose content primes the window, 0 = none
   };
   #pragma pack(pop)
 
@@ -51,16 +278,97 @@ namespace acf
   {
   private:
     CallbackFunc m_CallbackFunc;
+    CompressionProfile m_Profile;
+    uint64_t m_DecoderMemoryLimit = 0;
+    bool m_DecodePassthrough = false;
+    ExtractUpdate m_ExtractUpdate = ExtractUpdate::Off;
+    bool m_RestoreSpecialBits = false;
+    // Decoded content of the last prefix entry, reused by the rest of its group.
+    std::string m_PrefixCachePath;
+    uint64_t m_PrefixCacheOffset = 0;
+    uint32_t m_PrefixCacheCrc = 0;
+    std::vector<uint8_t> m_PrefixCache;
+    std::string m_BaseArchivePath;
+    // Base archive read or written against last, opened and indexed once.
+    struct BaseArchive;
+    std::shared_ptr<BaseArchive> m_Base;
+    std::string m_RepositoryPath;
+    std::shared_ptr<detail::ChunkRepository> m_Repository; // Opened on first use
+
+    // Repository of a manifest: the override set by SetRepository() or the
+    // path recorded after the header.
+    detail::ChunkRepository& ManifestRepository(std::istream& archiveFile, const ACFHeader& header,
+                                                const std::string& archivePath);
+    BaseArchive& OpenBase(const std::string& basePath);
+    // Content of a file entry already read from the central directory, CRC checked.
+    std::vector<uint8_t> ExtractEntryData(std::istream& archiveFile, const ACFHeader& header,
+                                          const std::string& archivePath, const ACFEntryData& entry,
+                                          const std::string& path);
+    void ExtractEntries(const std::string& archivePath,
+                        const std::vector<std::pair<ACFEntryData, std::string>>& entries,
+                        const std::string& outputPath);
+    // Create() and CreateFromList(): inputPaths is walked unless nextPath is set.
+    void WriteArchive(const std::string& archivePath,
+                      const std::vector<std::string>& inputPaths,
+                      const std::function<bool(std::string& path)>& nextPath,
+                      const std::string& basePath,
+                      const std::string& internalBasePath);
   public:
     ACFArchiver();
     virtual ~ACFArchiver();
     void SetCallback(const CallbackFunc callbackf);
+    void SetCompressionProfile(const CompressionProfile& profile);
+    // Largest decoder window ExtractData() will allocate; entries needing more are
+    // refused. 0 = no limit beyond what each entry records.
+    void SetDecoderMemoryLimit(uint64_t bytes);
+    // Passthrough entries extract as the original .zst bytes by default; with
+    // decode set they extract as decoded content (and lose the .zst suffix).
+    void SetDecodePassthrough(bool decode);
+    // Redeploy over an existing tree: files already up to date on disk are
+    // neither decoded nor written. With Crc, a stored .zst file extracted as
+    // it is is decoded on disk to check its content. Changed files are
+    // written to "<name>.acfpart" and renamed over the old version.
+    void SetExtractUpdate(ExtractUpdate update);
+    // Extraction restores only the permission bits of stored POSIX modes;
+    // with restore set also setuid, setgid and sticky (tar -p).
+    void SetRestoreSpecialBits(bool restore);
+    // Create() writes a delta archive against this archive. Extraction of a
+    // delta archive uses it instead of the recorded base next to the archive.
+    void SetBaseArchive(const std::string& basePath);
+    // Create() stores file content as deduplicated chunks in this repository
+    // and writes the archive as a manifest of chunk references. Extraction of a
+    // manifest uses it instead of the recorded repository path.
+    void SetRepository(const std::string& repositoryPath);
     
     void Create(const std::string& archivePath, 
                 const std::vector<std::string>& inputPaths,
                 const std::string& basePath,
                 const std::string& internalBasePath);
 
+    // Create() from a list of host paths that nextPath() hands out one at a
+    // time until it returns false; each file is stored as soon as it arrives.
+    // Paths are not walked or checked up front: a directory becomes a
+    // directory entry only, and of a repeated path only the first copy is
+    // listed. Needs FileOrder::Path and no layout profile, front index, read
+    // order or deadline, since those need the whole list first.
+    void CreateFromList(const std::string& archivePath,
+                        const std::function<bool(std::string& path)>& nextPath,
+                        const std::string& basePath,
+                        const std::string& internalBasePath);
+
+    // Dry run of Create(): walks the inputs, compresses a random sampleFraction of
+    // 1 MiB blocks with the current profile (the starting level in adaptive mode)
+    // and extrapolates archive size and single-threaded CPU and wall time.
+    // Pre-filters, .zst passthrough and aligned storage are decided per file as
+    // Create() does; passthrough inputs are costed without their decode. The
+    // intervals cover sampling error only. Throws for long-range mode, a base
+    // archive, a repository, a file order other than Path or a layout profile,
+    // which prime files with data the sample does not hold.
+    ArchiveEstimate Estimate(const std::vector<std::string>& inputPaths,
+                             const std::string& basePath,
+                             const std::string& internalBasePath,
+                             double sampleFraction);
+
     void CreateData(const std::string& archivePath, 
                 const std::string& internalPath,
                 const std::vector<uint8_t>& data);
@@ -78,5 +386,262 @@ namespace acf
     std::vector<std::pair<ACFEntryData, std::string>> List(const std::string& archivePath);
   };
 
+  struct BlockCacheStats
+  {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t blocks = 0;  // Blocks currently held
+    uint64_t bytes = 0;
+  };
+
+  // Decoded file content in blocks of kBlockSize, keyed by (archive, entry,
+  // block) and evicted least recently used first once capacityBytes is
+  // exceeded. The cache is split into shards with a lock each, so readers on
+  // many threads rarely wait for one another. One cache can back any number
+  // of ArchiveReaders.
+  class BlockCache
+  {
+  public:
+    using Block = std::shared_ptr<const std::vector<uint8_t>>;
+    static constexpr size_t kBlockSize = 256 << 10;
+
+    explicit BlockCache(size_t capacityBytes, size_t shardCount = 16);
+    ~BlockCache();
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    // Block, or nullptr when not cached; counts a hit or a miss.
+    Block Find(uint64_t archive, uint64_t entry, uint64_t block);
+    void Insert(uint64_t archive, uint64_t entry, uint64_t block, Block data);
+    BlockCacheStats Stats() const;
+    void Clear();
+
+  private:
+    struct Shard;
+    Shard& ShardFor(uint64_t archive, uint64_t entry, uint64_t block) const;
+
+    size_t m_ShardCapacity;
+    std::vector<std::unique_ptr<Shard>> m_Shards;
+  };
+
+  struct ArchiveReaderOptions
+  {
+    std::string basePath;       // Base of a delta archive, if not next to it under its recorded name
+    std::string repositoryPath; // Chunk repository of a manifest, if moved from its recorded path
+    std::shared_ptr<BlockCache> cache; // Optional; repeated reads are then served from memory
+    bool map = false;           // Map the archive; RawFrame() then returns views instead of copies, MappedData() works
+    bool recordAccess = false;  // Remember the order files are first read in; see AccessProfile()
+  };
+
+  // Stored bytes of a file exactly as they are in the archive: one or more
+  // zstd frames (or a stored .zst input) plus what is needed to decode and
+  // check them. Returned by ArchiveReader::RawFrame(), taken by
+  // ArchiveWriter::AddRawFrame().
+  struct StoredFrame
+  {
+    CompressionMethod method = CompressionMethod::Zstd;
+    uint64_t originalSize = 0;
+    uint64_t compressedSize = 0;
+    uint32_t crc32 = 0;         // Of the decoded content
+    uint8_t windowLog = 0;
+    FilterType filter = FilterType::None;
+    uint8_t filterParam = 0;
+    uint32_t filedatetime = 0;
+    uint8_t fileattribute = 0;
+    uint32_t unixMode = 0;
+    std::span<const uint8_t> data;  // compressedSize bytes
+    // Owns data when it is a copy; empty for a view into a mapped archive,
+    // which stays valid as long as the reader.
+    std::shared_ptr<const void> owner;
+  };
+
+  // Content of every file of an archive in one allocation, returned by
+  // ArchiveReader::LoadAll(). Files are laid out in the order they are
+  // stored; stored .zst inputs come out as stored, as with Read().
+  struct LoadedArchive
+  {
+    std::unique_ptr<uint8_t[]> arena;
+    uint64_t size = 0;
+    std::unordered_map<std::string, std::span<const uint8_t>> files; // Views into arena, by path
+  };
+
+  class ArchiveReader;
+
+  // One file of an ArchiveReader, decoded lazily as it is read. Content is
+  // produced in BlockCache::kBlockSize blocks from the start of the entry;
+  // the last block is kept, and with a block cache all blocks are shared
+  // with other handles. Reading behind the decoder position restarts the
+  // frame unless the block is cached. Stored .zst inputs, uncompressed
+  // files and chunk references are read in place. Use a handle from one
+  // thread at a time; it must not outlive its reader.
+  class ArchiveFile
+  {
+  public:
+    ~ArchiveFile();
+    ArchiveFile(const ArchiveFile&) = delete;
+    ArchiveFile& operator=(const ArchiveFile&) = delete;
+
+    const ACFEntryData& Entry() const;
+    uint64_t Size() const;
+    // Copies up to length bytes at offset into buffer and returns the count,
+    // 0 at or past the end. The CRC is checked once the last block is decoded.
+    size_t Read(uint64_t offset, void* buffer, size_t length);
+
+  private:
+    friend class ArchiveReader;
+    class Impl;
+    explicit ArchiveFile(std::unique_ptr<Impl> impl);
+    std::unique_ptr<Impl> m_Impl;
+  };
+
+  // Read-only access to one archive that any number of threads can share.
+  // The central directory is read once into an immutable index, content is
+  // read with positional reads on one descriptor and decoded with a zstd
+  // context per thread, so concurrent Read() calls do not wait for each other.
+  class ArchiveReader
+  {
+  public:
+    explicit ArchiveReader(const std::string& archivePath, const ArchiveReaderOptions& options = {});
+    ~ArchiveReader();
+    ArchiveReader(const ArchiveReader&) = delete;
+    ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+    const std::string& Path() const;
+    // Entries in central directory order.
+    const std::vector<std::pair<ACFEntryData, std::string>>& Entries() const;
+    // Entry stored under path, or nullptr.
+    const ACFEntryData* Find(const std::string& path) const;
+    // Content of a file, CRC checked. As with ExtractData(), stored .zst
+    // inputs are returned as stored. With a block cache, content is checked
+    // when decoded and later reads of it are copied from the cache.
+    std::vector<uint8_t> Read(const std::string& path) const;
+    // Handle for incremental reads of a file.
+    std::unique_ptr<ArchiveFile> Open(const std::string& path) const;
+    // Compressed bytes of a file, without decoding them. Only entries that
+    // decode on their own qualify: not patched from a base, primed with a
+    // prefix or split into repository chunks.
+    StoredFrame RawFrame(const std::string& path) const;
+    // Bytes of an uncompressed file inside the mapping of an archive opened
+    // with ArchiveReaderOptions::map, valid as long as the reader. Nothing
+    // is copied or checked, so pages are only read when they are used;
+    // throws for compressed files and unmapped archives.
+    std::span<const uint8_t> MappedData(const std::string& path) const;
+    // Decodes every file into one arena sized from the central directory,
+    // on threads (0 = one per core) that each take the next file in storage
+    // order. CRCs are checked; the block cache is bypassed.
+    LoadedArchive LoadAll(unsigned threads = 0) const;
+    // Files in the order they were first read through Read(), Open(),
+    // RawFrame() or MappedData(), with ArchiveReaderOptions::recordAccess.
+    std::vector<std::string> AccessProfile() const;
+    // Writes AccessProfile() one path per line, the layout profile format
+    // read by LoadAccessProfile().
+    void SaveAccessProfile(const std::string& profilePath) const;
+
+  private:
+    friend class ArchiveFile;
+    class Impl;
+    std::unique_ptr<Impl> m_Impl;
+  };
+
+  // Reads a layout profile: one archive path per line, empty lines and lines
+  // starting with '#' ignored.
+  std::vector<std::string> LoadAccessProfile(const std::string& profilePath);
+
+  // Builds an archive from already compressed files, such as frames taken
+  // from other archives with ArchiveReader::RawFrame(). Frames are copied
+  // as they are, without recompression; their size, magic and recorded CRC
+  // are trusted. Entries keep the order they were added in.
+  class ArchiveWriter
+  {
+  public:
+    explicit ArchiveWriter(const std::string& archivePath);
+    // Closes the archive if Close() was not called; errors are lost then.
+    ~ArchiveWriter();
+    ArchiveWriter(const ArchiveWriter&) = delete;
+    ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+    void AddDirectory(const std::string& path, uint32_t filedatetime = 0,
+                      uint8_t fileattribute = ATTR_DIRECTORY, uint32_t unixMode = 0);
+    void AddRawFrame(const std::string& path, const StoredFrame& frame);
+    // Writes the central directory and the header.
+    void Close();
+
+  private:
+    class Impl;
+    std::unique_ptr<Impl> m_Impl;
+  };
+
+  struct VfsStat
+  {
+    bool directory = false;
+    uint64_t size = 0;          // Bytes ArchiveFile::Read() yields; 0 for directories
+    uint32_t filedatetime = 0;  // As in ACFEntryData; 0 for directories without an entry
+    uint8_t fileattribute = 0;
+    uint32_t unixMode = 0;
+  };
+
+  struct VfsDirEntry
+  {
+    std::string name;
+    VfsStat stat;
+  };
+
+  // Archive content as a read-only file tree. Paths are relative to the
+  // archive root, with or without a leading '/'; "" and "/" name the root.
+  // Directories that only appear as parents of stored paths exist too. All
+  // calls are safe from any number of threads.
+  class ArchiveVfs
+  {
+  public:
+    explicit ArchiveVfs(std::shared_ptr<const ArchiveReader> reader);
+    ~ArchiveVfs();
+    ArchiveVfs(const ArchiveVfs&) = delete;
+    ArchiveVfs& operator=(const ArchiveVfs&) = delete;
+
+    const ArchiveReader& Reader() const;
+    // False when nothing exists at path.
+    bool Stat(const std::string& path, VfsStat& stat) const;
+    // Stored entry at path; nullptr if there is none, as for implied directories.
+    const ACFEntryData* Find(const std::string& path) const;
+    // Throws unless path is a file.
+    std::unique_ptr<ArchiveFile> Open(const std::string& path) const;
+    // Entries directly below a directory, sorted by name; throws unless path is one.
+    std::vector<VfsDirEntry> ReadDir(const std::string& path) const;
+
+  private:
+    class Impl;
+    std::unique_ptr<Impl> m_Impl;
+  };
+
+
+  // Client of acfd, the daemon that keeps archive indexes, decoders and a
+  // block cache warm between requests. Archive paths are made absolute
+  // before they are sent. One request at a time per client; a connection
+  // the daemon closed while idle is opened again. Not available on Windows.
+  class DaemonClient
+  {
+  public:
+    // $ACFD_SOCKET, else $XDG_RUNTIME_DIR/acfd.sock, else /tmp/acfd-<uid>.sock.
+    static std::string DefaultSocketPath();
+
+    explicit DaemonClient(const std::string& socketPath = DefaultSocketPath());
+    ~DaemonClient();
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient& operator=(const DaemonClient&) = delete;
+
+    std::vector<std::pair<ACFEntryData, std::string>> List(const std::string& archivePath);
+    // False when the archive has no entry at path.
+    bool Stat(const std::string& archivePath, const std::string& path, ACFEntryData& entry);
+    std::vector<uint8_t> Read(const std::string& archivePath, const std::string& path);
+    // Request latency and cache counters in the Prometheus text format.
+    std::string Metrics();
+
+  private:
+    void Connect();
+    std::vector<uint8_t> Call(const std::vector<std::string>& request);
+    std::string m_SocketPath;
+    int m_Socket = -1;
+  };
 
 } // namespace acf
@@ -1,4 +1,8 @@
 #include "acf.hh"
+#include "acfplatform.hh"
+#include "acfinternal.hh"
+#include "acffilter.hh"
+#include "acfrepo.hh"
 #include <stdexcept> 
 #include <fstream>   
 #include <filesystem>
@@ -7,25 +11,10 @@
 #include <utility>
 #include <unordered_set>
 #include <algorithm>
-#include <windows.h>
 #include <chrono>
-
-// --- Utility Functions ---
-std::wstring StringToWString(const std::string& s) {
-    if (s.empty()) return std::wstring();
-    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), NULL, 0);
-    std::wstring r(len, 0);
-    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), &r[0], len);
-    return r;
-}
-
-std::string WStringToString(const std::wstring& s) {
-    if (s.empty()) return std::string();
-    int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), (int)s.length(), NULL, 0, NULL, NULL);
-    std::string r(len, 0);
-    WideCharToMultiByte(CP_UTF8, 0, s.c_str(), (int)s.length(), &r[0], len, NULL, NULL);
-    return r;
-}
+#include <cstring>
+#include <cmath>
+#include <numeric>
 
 namespace { // Anonymous namespace for internal helpers
 
@@ -57,19 +46,131 @@ uint32_t crc32(const void* data, size_t len) {
 }
 
 
-// --- Date/Time Conversion ---
-uint32_t FileTimeToDosDateTime(const FILETIME& ft) {
-    WORD dosDate, dosTime;
-    // Do not convert to local time; Total Commander likely expects UTC.
-    FileTimeToDosDateTime(&ft, &dosDate, &dosTime);
-    return (static_cast<uint32_t>(dosDate) << 16) | dosTime;
+// --- Central Directory ---
+// Archives written on Windows before v1.0 used '\\' as the separator; '/' is the internal form.
+std::string NormalizeInternalPath(std::string path) {
+    std::replace(path.begin(), path.end(), '\\', '/');
+    return path;
 }
 
-FILETIME DosDateTimeToFileTime(uint32_t dosDateTime) {
-    FILETIME ft, lft;
-    DosDateTimeToFileTime(static_cast<WORD>(dosDateTime >> 16), static_cast<WORD>(dosDateTime & 0xFFFF), &lft);
-    LocalFileTimeToFileTime(&lft, &ft); // Convert to UTC
-    return ft;
+size_t EntryRecordSize(const acf::ACFHeader& header) {
+    return header.entrySize ? header.entrySize : acf::ACF_ENTRY_SIZE_V09;
+}
+
+// Fields newer than the archive stay zero, fields unknown to this reader are skipped.
+bool ParseEntry(const char*& ptr, const char* end, size_t recordSize, acf::ACFEntryData& entry, std::string& path) {
+    if (ptr + recordSize > end) return false;
+    entry = acf::ACFEntryData{};
+    memcpy(&entry, ptr, std::min(recordSize, sizeof(acf::ACFEntryData)));
+    ptr += recordSize;
+
+    if (ptr + entry.pathLength > end) return false;
+    path = NormalizeInternalPath(std::string(ptr, entry.pathLength));
+    ptr += entry.pathLength;
+    return true;
+}
+
+bool ReadEntry(std::istream& in, size_t recordSize, acf::ACFEntryData& entry, std::string& path) {
+    std::vector<char> record(recordSize);
+    if (!in.read(record.data(), recordSize)) return false;
+    entry = acf::ACFEntryData{};
+    memcpy(&entry, record.data(), std::min(recordSize, sizeof(acf::ACFEntryData)));
+
+    std::string rawPath(entry.pathLength, '\0');
+    if (!in.read(&rawPath[0], entry.pathLength)) return false;
+    path = NormalizeInternalPath(std::move(rawPath));
+    return true;
+}
+
+// --- Path Patterns ---
+bool GlobMatchFrom(const char* p, const char* s) {
+    for (; *p; ++p, ++s) {
+        if (*p == '*') {
+            const bool crossDirs = p[1] == '*';
+            while (*p == '*') ++p;
+            if (crossDirs && *p == '/' && GlobMatchFrom(p + 1, s)) return true; // "a/**/b" also matches "a/b"
+            for (;; ++s) {
+                if (GlobMatchFrom(p, s)) return true;
+                if (!*s || (!crossDirs && *s == '/')) return false;
+            }
+        }
+        if (!*s || (*p == '?' ? *s == '/' : *p != *s)) return false;
+    }
+    return !*s;
+}
+
+// --- Walk Filter ---
+// One line of an ignore file, or one exclude pattern.
+struct IgnoreRule
+{
+    std::string pattern;
+    bool negate = false;   // '!': re-include what an earlier rule excluded
+    bool dirOnly = false;  // Trailing '/'
+    bool anchored = false; // Leading '/': only directly below the rule's directory
+};
+
+// Rules of the ignore file of one directory; base is that directory relative
+// to the walked input, with a trailing '/' ("" for the input itself).
+struct IgnoreRules
+{
+    std::string base;
+    std::vector<IgnoreRule> rules;
+};
+
+IgnoreRule ParseIgnoreRule(std::string pattern) {
+    IgnoreRule rule;
+    if (!pattern.empty() && pattern[0] == '!') {
+        rule.negate = true;
+        pattern.erase(0, 1);
+    }
+    if (!pattern.empty() && pattern.back() == '/') {
+        rule.dirOnly = true;
+        pattern.pop_back();
+    }
+    if (!pattern.empty() && pattern[0] == '/') {
+        rule.anchored = true;
+        pattern.erase(0, 1);
+    }
+    rule.pattern = std::move(pattern);
+    return rule;
+}
+
+std::vector<IgnoreRule> LoadIgnoreFile(const std::filesystem::path& p) {
+    std::vector<IgnoreRule> rules;
+    std::ifstream in(p);
+    std::string line;
+    while (std::getline(in, line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        IgnoreRule rule = ParseIgnoreRule(line);
+        if (!rule.pattern.empty()) rules.push_back(std::move(rule));
+    }
+    return rules;
+}
+
+bool RuleMatches(const IgnoreRule& rule, const std::string& path, bool isDirectory) {
+    if (rule.dirOnly && !isDirectory) return false;
+    if (rule.anchored && rule.pattern.find('/') == std::string::npos && path.find('/') != std::string::npos) return false;
+    return acf::detail::GlobMatch(rule.pattern, path);
+}
+
+// Whether a path relative to the walked input is excluded: by any exclude
+// pattern, else by the last matching line of the ignore files from the
+// input down to the path's parent.
+bool IsExcluded(const std::vector<IgnoreRule>& excludes, const std::vector<IgnoreRules>& ignoreStack,
+                const std::string& path, bool isDirectory) {
+    for (const auto& rule : excludes) {
+        if (RuleMatches(rule, path, isDirectory)) return true;
+    }
+    bool excluded = false;
+    for (const auto& level : ignoreStack) {
+        if (path.compare(0, level.base.size(), level.base) != 0) continue;
+        const std::string relative = path.substr(level.base.size());
+        for (const auto& rule : level.rules) {
+            if (RuleMatches(rule, relative, isDirectory)) excluded = !rule.negate;
+        }
+    }
+    return excluded;
 }
 
 // --- ZSTD Stream Wrappers (RAII) ---
@@ -79,8 +180,426 @@ using ZSTD_CStream_Ptr = std::unique_ptr<ZSTD_CStream, ZSTD_CStream_Deleter>;
 struct ZSTD_DStream_Deleter { void operator()(ZSTD_DStream* ptr) const { ZSTD_freeDStream(ptr); } };
 using ZSTD_DStream_Ptr = std::unique_ptr<ZSTD_DStream, ZSTD_DStream_Deleter>;
 
+// --- Incremental Extraction ---
+enum class DiskState { Changed, Current, MetadataOnly };
+
+// Compares an existing file with the entry about to be extracted to it.
+// size is what the entry extracts to; stored is set where that is a stored
+// .zst input, whose CRC is of the decoded content.
+DiskState CompareWithDisk(const std::filesystem::path& p, const acf::ACFEntryData& entry, uint64_t size,
+                          acf::ExtractUpdate update, bool stored) {
+    acf::platform::FileInfo info;
+    if (!acf::platform::Stat(p, info) || !info.regular || info.size != size) return DiskState::Changed;
+    const bool modeMatches = entry.unixMode == 0 || info.unixMode == 0 || (info.unixMode & 07777) == (entry.unixMode & 07777);
+    if (update == acf::ExtractUpdate::SizeTime) {
+        if (info.dosDateTime != entry.filedatetime) return DiskState::Changed;
+        return modeMatches ? DiskState::Current : DiskState::MetadataOnly;
+    }
+
+    acf::platform::FileReader reader;
+    if (!reader.Open(p, info)) return DiskState::Changed;
+    ZSTD_DStream_Ptr dstream(stored ? ZSTD_createDStream() : nullptr);
+    if (stored) {
+        if (!dstream) throw std::runtime_error("ZSTD_createDStream() error");
+        ZSTD_DCtx_setParameter(dstream.get(), ZSTD_d_windowLogMax,
+                               entry.windowLog ? entry.windowLog : acf::detail::kDefaultWindowLogMax);
+    }
+    std::vector<char> buffer(1 << 20);
+    std::vector<char> decoded(stored ? ZSTD_DStreamOutSize() : 0);
+    uint32_t crc = 0;
+    size_t remaining = 0;
+    while (size_t readCount = reader.Read(buffer.data(), buffer.size())) {
+        if (!stored) {
+            crc = crc32_update(crc, buffer.data(), readCount);
+            continue;
+        }
+        ZSTD_inBuffer in = { buffer.data(), readCount, 0 };
+        for (;;) {
+            ZSTD_outBuffer out = { decoded.data(), decoded.size(), 0 };
+            remaining = ZSTD_decompressStream(dstream.get(), &out, &in);
+            if (ZSTD_isError(remaining)) return DiskState::Changed;
+            crc = crc32_update(crc, decoded.data(), out.pos);
+            if (in.pos == in.size && out.pos < out.size) break; // Input used up and output flushed
+        }
+    }
+    if (stored && remaining != 0) return DiskState::Changed;
+    if (crc != entry.crc32) return DiskState::Changed;
+    return info.dosDateTime == entry.filedatetime && modeMatches ? DiskState::Current : DiskState::MetadataOnly;
+}
+
+// Flushes and closes the current frame. Returns the number of bytes written.
+uint64_t EndFrame(ZSTD_CStream* cstream, std::vector<char>& outBuff, std::ostream& out) {
+    uint64_t written = 0;
+    size_t remaining;
+    do {
+        ZSTD_outBuffer outBuffer = { outBuff.data(), outBuff.size(), 0 };
+        remaining = ZSTD_endStream(cstream, &outBuffer);
+        if (ZSTD_isError(remaining)) {
+            throw std::runtime_error("ZSTD_endStream error");
+        }
+        out.write(outBuff.data(), outBuffer.pos);
+        written += outBuffer.pos;
+    } while (remaining != 0);
+    return written;
+}
+
+// --- Long-Range Mode ---
+using acf::detail::kDefaultWindowLogMax;
+constexpr uint64_t kMaxPrefix = 8 << 20; // Largest file used as prefix for similar files
+
+// Smallest window covering the whole file, within [2^27, 2^maxWindowLog].
+int LongRangeWindowLog(const acf::CompressionProfile& profile, uint64_t fileSize) {
+    if (!profile.longRange || fileSize < profile.longRangeMinSize) return 0;
+    int windowLog = kDefaultWindowLogMax;
+    while (windowLog < 63 && (1ull << windowLog) < fileSize) ++windowLog;
+    int upper = std::min(profile.maxWindowLog, ZSTD_cParam_getBounds(ZSTD_c_windowLog).upperBound);
+    return std::clamp(windowLog, kDefaultWindowLogMax, std::max(upper, kDefaultWindowLogMax));
+}
+
+void StartFrame(ZSTD_CStream* cstream, int level, int strategy, int windowLog) {
+    ZSTD_CCtx_reset(cstream, ZSTD_reset_session_and_parameters);
+    ZSTD_CCtx_setParameter(cstream, ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setParameter(cstream, ZSTD_c_strategy, strategy);
+    if (windowLog > 0) {
+        ZSTD_CCtx_setParameter(cstream, ZSTD_c_enableLongDistanceMatching, 1);
+        ZSTD_CCtx_setParameter(cstream, ZSTD_c_windowLog, windowLog);
+    }
+}
+
+// --- Delta Archives ---
+// Window reaching from the end of a file back to the start of its base
+// version, or 0 when that exceeds the profile's limit.
+int PatchWindowLog(const acf::CompressionProfile& profile, uint64_t baseSize, uint64_t fileSize) {
+    int windowLog = ZSTD_cParam_getBounds(ZSTD_c_windowLog).lowerBound;
+    while (windowLog < 63 && (1ull << windowLog) < baseSize + fileSize) ++windowLog;
+    int upper = std::min(profile.maxWindowLog, ZSTD_cParam_getBounds(ZSTD_c_windowLog).upperBound);
+    if (windowLog > upper) return 0;
+    return std::max(windowLog, LongRangeWindowLog(profile, fileSize));
+}
+
+// Reads the base record of a delta archive and resolves the base archive.
+std::string ResolveBaseArchive(std::istream& archiveFile, const acf::ACFHeader& header,
+                               const std::string& archivePath, const std::string& overridePath) {
+    if (!(header.flags & acf::ACF_FLAG_BASE)) {
+        throw std::runtime_error("Archive has patched entries but no base record: " + archivePath);
+    }
+    acf::ACFBaseRecord record{};
+    archiveFile.clear();
+    archiveFile.seekg(sizeof(acf::ACFHeader));
+    archiveFile.read(reinterpret_cast<char*>(&record), sizeof(record));
+    std::string name(record.nameLength, '\0');
+    archiveFile.read(name.data(), name.size());
+    if (!archiveFile) {
+        throw std::runtime_error("Could not read base record of archive: " + archivePath);
+    }
+    return acf::detail::ResolveBaseArchive(record, name, archivePath, overridePath);
+}
+
+// --- zstd Passthrough ---
+constexpr uint32_t kZstdMagic = 0xFD2FB528;
+
+// Window log declared by a zstd frame header, or -1 if the header is incomplete.
+int FrameWindowLog(const uint8_t* p, size_t size) {
+    if (size < 6) return -1;
+    const uint8_t fhd = p[4];
+    const bool singleSegment = (fhd >> 5) & 1;
+    if (!singleSegment) {
+        const uint8_t wd = p[5];
+        const int windowLog = 10 + (wd >> 3);
+        return (wd & 7) ? windowLog + 1 : windowLog; // Mantissa rounds the window up
+    }
+    // Single-segment frames use the content size as window.
+    static const size_t kDictIdSize[] = { 0, 1, 2, 4 };
+    static const size_t kContentSizeSize[] = { 1, 2, 4, 8 };
+    size_t pos = 5 + kDictIdSize[fhd & 3];
+    size_t fcsSize = kContentSizeSize[fhd >> 6];
+    if (pos + fcsSize > size) return -1;
+    uint64_t contentSize = 0;
+    for (size_t i = 0; i < fcsSize; ++i) contentSize |= static_cast<uint64_t>(p[pos + i]) << (8 * i);
+    if (fcsSize == 2) contentSize += 256;
+    int windowLog = 10;
+    while (windowLog < 63 && (1ull << windowLog) < contentSize) ++windowLog;
+    return windowLog;
+}
+
+// Copies an input that starts with a zstd frame verbatim while decoding it to
+// compute size and CRC of its content. Returns false when the input is not a
+// clean sequence of frames (truncated, trailing garbage, needs a dictionary or
+// a window above what this build decodes); the caller then falls back to
+// compression. `wroteAny` tells whether the output must be rolled back.
+bool CopyZstdPassthrough(acf::platform::FileReader& input, std::ostream& out, std::vector<char>& inBuff,
+                         acf::ACFEntryData& entry, bool& wroteAny) {
+    wroteAny = false;
+    size_t readCount = input.Read(inBuff.data(), inBuff.size());
+    uint32_t magic = 0;
+    if (readCount < sizeof(magic)) return false;
+    memcpy(&magic, inBuff.data(), sizeof(magic));
+    if (magic != kZstdMagic) return false;
+
+    int windowLog = FrameWindowLog(reinterpret_cast<const uint8_t*>(inBuff.data()), readCount);
+    if (windowLog < 0 || windowLog > ZSTD_dParam_getBounds(ZSTD_d_windowLogMax).upperBound) return false;
+
+    ZSTD_DStream_Ptr dstream(ZSTD_createDStream());
+    if (!dstream) return false;
+    ZSTD_initDStream(dstream.get());
+    ZSTD_DCtx_setParameter(dstream.get(), ZSTD_d_windowLogMax, std::max(windowLog, kDefaultWindowLogMax));
+    std::vector<char> outBuff(ZSTD_DStreamOutSize());
+
+    uint64_t storedSize = 0, decodedSize = 0;
+    uint32_t crc = 0;
+    size_t ret = 0;
+    while (readCount > 0) {
+        out.write(inBuff.data(), readCount);
+        wroteAny = true;
+        storedSize += readCount;
+
+        ZSTD_inBuffer inBuffer = { inBuff.data(), readCount, 0 };
+        while (inBuffer.pos < inBuffer.size) {
+            ZSTD_outBuffer outBuffer = { outBuff.data(), outBuff.size(), 0 };
+            ret = ZSTD_decompressStream(dstream.get(), &outBuffer, &inBuffer);
+            if (ZSTD_isError(ret)) return false;
+            crc = crc32_update(crc, outBuff.data(), outBuffer.pos);
+            decodedSize += outBuffer.pos;
+        }
+        readCount = input.Read(inBuff.data(), inBuff.size());
+    }
+    if (ret != 0) return false; // Last frame incomplete
+
+    entry.method = acf::CompressionMethod::ZstdPassthrough;
+    entry.originalSize = decodedSize;
+    entry.compressedSize = storedSize;
+    entry.crc32 = crc;
+    entry.windowLog = static_cast<uint8_t>(windowLog > kDefaultWindowLogMax ? windowLog : 0);
+    return true;
+}
+
+// --- Adaptive Level Control ---
+// Measures end-to-end input throughput (read + compress + write) over blocks of
+// input and moves the level used for the following blocks, similar to zstd --adapt.
+class LevelController
+{
+public:
+    LevelController(const acf::CompressionProfile& profile, uint64_t totalBytes)
+        : m_Profile(profile), m_Level(profile.level), m_TotalBytes(totalBytes),
+          m_Start(std::chrono::steady_clock::now()), m_BlockStart(m_Start)
+    {
+        if (m_Profile.adaptive) {
+            m_Level = std::clamp(m_Level, m_Profile.minLevel, m_Profile.maxLevel);
+        }
+    }
+
+    int Level() const { return m_Level; }
+
+    // Accounts consumed input. Returns true when the level for the next block changed.
+    bool Update(uint64_t bytes) {
+        if (!m_Profile.adaptive) return false;
+        m_BlockBytes += bytes;
+        m_DoneBytes += bytes;
+        if (m_BlockBytes < kBlockSize) return false;
+
+        auto now = std::chrono::steady_clock::now();
+        double blockSeconds = std::chrono::duration<double>(now - m_BlockStart).count();
+        double measuredMBps = blockSeconds > 0 ? (m_BlockBytes / 1e6) / blockSeconds : 1e9;
+        m_BlockBytes = 0;
+        m_BlockStart = now;
+
+        double targetMBps = TargetMBps(now);
+        if (targetMBps <= 0) return false;
+
+        int newLevel = m_Level;
+        if (measuredMBps < targetMBps * 0.9) {
+            // Far below target: take bigger steps down, one per halving of the rate.
+            newLevel -= std::clamp(static_cast<int>(std::ceil(std::log2(targetMBps / measuredMBps))), 1, 4);
+        } else if (measuredMBps > targetMBps * 1.2) {
+            newLevel += 1;
+        }
+        newLevel = std::clamp(newLevel, m_Profile.minLevel, m_Profile.maxLevel);
+        if (newLevel == m_Level) return false;
+        m_Level = newLevel;
+        return true;
+    }
+
+private:
+    static constexpr uint64_t kBlockSize = 8 << 20;
+
+    // With a deadline the target is whatever rate still finishes the remaining input in time.
+    double TargetMBps(std::chrono::steady_clock::time_point now) const {
+        if (m_Profile.deadlineSeconds <= 0) return m_Profile.targetMBps;
+        double elapsed = std::chrono::duration<double>(now - m_Start).count();
+        double remainingSeconds = m_Profile.deadlineSeconds - elapsed;
+        uint64_t remainingBytes = m_TotalBytes > m_DoneBytes ? m_TotalBytes - m_DoneBytes : 0;
+        if (remainingSeconds <= 0) return 1e9; // Already late: run as fast as possible
+        return (remainingBytes / 1e6) / remainingSeconds;
+    }
+
+    acf::CompressionProfile m_Profile;
+    int m_Level;
+    uint64_t m_TotalBytes;
+    uint64_t m_DoneBytes = 0;
+    uint64_t m_BlockBytes = 0;
+    std::chrono::steady_clock::time_point m_Start;
+    std::chrono::steady_clock::time_point m_BlockStart;
+};
+
 } // namespace
 
+namespace acf::detail
+{
+  void CollectInputs(const std::vector<std::string>& inputPaths,
+                     std::vector<std::filesystem::path>& files,
+                     std::vector<std::filesystem::path>& dirs,
+                     const CompressionProfile& filter)
+  {
+    namespace fs = std::filesystem;
+
+    std::unordered_set<fs::path> processedPaths;
+    std::vector<IgnoreRule> excludes;
+    for (const auto& pattern : filter.exclude) excludes.push_back(ParseIgnoreRule(pattern));
+    auto included = [&](const std::string& path) {
+        return filter.include.empty() ||
+               std::any_of(filter.include.begin(), filter.include.end(), [&](const std::string& pattern) { return GlobMatch(pattern, path); });
+    };
+
+    for (const auto& inputPathStr : inputPaths) {
+        fs::path inputPath(inputPathStr);
+        if (!fs::exists(inputPath) || processedPaths.count(inputPath)) continue;
+
+        const bool inputIsDirectory = fs::is_directory(inputPath);
+        std::string given = platform::ToInternalPath(inputPath.lexically_normal());
+        while (given.size() > 1 && given.back() == '/') given.pop_back();
+        if (IsExcluded(excludes, {}, given, inputIsDirectory)) continue;
+
+        if (inputIsDirectory) {
+            if (processedPaths.find(inputPath) == processedPaths.end()) {
+                dirs.push_back(inputPath);
+                processedPaths.insert(inputPath);
+            }
+            // Ignore files of the input and of each directory above the
+            // current entry; excluded directories are not descended into.
+            std::vector<IgnoreRules> ignoreStack;
+            if (!filter.ignoreFileName.empty()) ignoreStack.push_back({ std::string(), LoadIgnoreFile(inputPath / filter.ignoreFileName) });
+            for (auto it = fs::recursive_directory_iterator(inputPath); it != fs::recursive_directory_iterator(); ++it) {
+                const fs::directory_entry& dir_entry = *it;
+                if (!filter.ignoreFileName.empty()) ignoreStack.resize(std::min<size_t>(ignoreStack.size(), it.depth() + 1));
+                const bool isDirectory = dir_entry.is_directory();
+                const std::string relative = platform::ToInternalPath(dir_entry.path().lexically_relative(inputPath));
+                if (IsExcluded(excludes, ignoreStack, relative, isDirectory)) {
+                    if (isDirectory) it.disable_recursion_pending();
+                    continue;
+                }
+                if (processedPaths.count(dir_entry.path())) continue;
+                if (isDirectory) {
+                    dirs.push_back(dir_entry.path());
+                    if (!filter.ignoreFileName.empty()) {
+                        ignoreStack.push_back({ relative + '/', LoadIgnoreFile(dir_entry.path() / filter.ignoreFileName) });
+                    }
+                } else if (dir_entry.is_regular_file() && included(relative)) {
+                    files.push_back(dir_entry.path());
+                }
+                processedPaths.insert(dir_entry.path());
+            }
+        } else if (fs::is_regular_file(inputPath)) {
+            files.push_back(inputPath);
+            processedPaths.insert(inputPath);
+        }
+    }
+    
+    std::sort(dirs.begin(), dirs.end());
+    std::sort(files.begin(), files.end());
+  }
+
+  uint32_t Crc32Update(uint32_t crc, const void* data, size_t len) {
+    return crc32_update(crc, data, len);
+  }
+
+  std::string InternalPathFor(const std::filesystem::path& p,
+                              const std::filesystem::path& basePath,
+                              const std::string& internalBasePath,
+                              bool isDirectory)
+  {
+    namespace fs = std::filesystem;
+    fs::path relativePath = fs::relative(p, basePath);
+    std::string internalPath = platform::ToInternalPath(fs::path(internalBasePath) / relativePath);
+    if (isDirectory && !internalPath.empty() && internalPath.back() != '/') {
+        internalPath += '/';
+    }
+    return internalPath;
+  }
+
+  std::string NormalizeInternalPath(const std::string& path) {
+    return ::NormalizeInternalPath(path);
+  }
+
+  bool IsSafeInternalPath(const std::string& path) {
+    const std::string normalized = ::NormalizeInternalPath(path);
+    if (!normalized.empty() && normalized[0] == '/') return false;
+    if (normalized.size() >= 2 && normalized[1] == ':') return false;
+    size_t start = 0;
+    while (start <= normalized.size()) {
+        size_t end = normalized.find('/', start);
+        if (end == std::string::npos) end = normalized.size();
+        if (normalized.compare(start, end - start, "..") == 0) return false;
+        start = end + 1;
+    }
+    return true;
+  }
+
+  bool GlobMatch(const std::string& pattern, const std::string& path) {
+    if (pattern.find('/') != std::string::npos) return GlobMatchFrom(pattern.c_str(), path.c_str());
+    const size_t slash = path.rfind('/');
+    return GlobMatchFrom(pattern.c_str(), path.c_str() + (slash == std::string::npos ? 0 : slash + 1));
+  }
+
+  std::vector<std::pair<ACFEntryData, std::string>> ParseCentralDirectory(const char* data, size_t size,
+                                                                          const ACFHeader& header)
+  {
+    std::vector<std::pair<ACFEntryData, std::string>> fileList;
+    fileList.reserve(header.entryCount);
+
+    const char* buffer_ptr = data;
+    const char* buffer_end = data + size;
+    const size_t recordSize = EntryRecordSize(header);
+
+    for (uint64_t i = 0; i < header.entryCount; ++i)
+    {
+      ACFEntryData entryData;
+      std::string path;
+      if (!ParseEntry(buffer_ptr, buffer_end, recordSize, entryData, path)) break;
+      fileList.emplace_back(entryData, path);
+    }
+    return fileList;
+  }
+
+  std::string ResolveBaseArchive(const ACFBaseRecord& record, const std::string& name,
+                                 const std::string& archivePath, const std::string& overridePath)
+  {
+    namespace fs = std::filesystem;
+    std::string basePath = overridePath.empty()
+        ? (fs::path(archivePath).parent_path() / platform::FromInternalPath(name)).string()
+        : overridePath;
+    std::ifstream baseFile(basePath, std::ios::binary);
+    if (!baseFile) {
+        throw std::runtime_error("Base archive not found: " + basePath);
+    }
+    ACFHeader baseHeader;
+    baseFile.read(reinterpret_cast<char*>(&baseHeader), sizeof(baseHeader));
+    std::error_code ec;
+    if (!baseFile || baseHeader.magic != ACF_MAGIC || baseHeader.centralDirCRC32 != record.centralDirCRC32 ||
+        fs::file_size(basePath, ec) != record.archiveSize) {
+        throw std::runtime_error("Base archive " + basePath + " is not the one " + archivePath + " was created against (" + name + ")");
+    }
+    return basePath;
+  }
+
+  std::string RecordedRepositoryPath(const std::string& recorded, const std::string& archivePath)
+  {
+    namespace fs = std::filesystem;
+    fs::path p = platform::FromInternalPath(recorded);
+    return (p.is_absolute() ? p : fs::path(archivePath).parent_path() / p).string();
+  }
+
+} // namespace acf::detail
+
 namespace acf
 {
   ACFArchiver::ACFArchiver() : m_CallbackFunc(nullptr) {}
@@ -90,12 +609,125 @@ namespace acf
     m_CallbackFunc = callbackf;
   }
 
+  void ACFArchiver::SetCompressionProfile(const CompressionProfile& profile) {
+    m_Profile = profile;
+  }
+
+  void ACFArchiver::SetDecoderMemoryLimit(uint64_t bytes) {
+    m_DecoderMemoryLimit = bytes;
+  }
+
+  void ACFArchiver::SetDecodePassthrough(bool decode) {
+    m_DecodePassthrough = decode;
+  }
+
+  void ACFArchiver::SetExtractUpdate(ExtractUpdate update) {
+    m_ExtractUpdate = update;
+  }
+
+  void ACFArchiver::SetRestoreSpecialBits(bool restore) {
+    m_RestoreSpecialBits = restore;
+  }
+
+  void ACFArchiver::SetBaseArchive(const std::string& basePath) {
+    m_BaseArchivePath = basePath;
+  }
+
+  void ACFArchiver::SetRepository(const std::string& repositoryPath) {
+    m_RepositoryPath = repositoryPath;
+  }
+
+  detail::ChunkRepository& ACFArchiver::ManifestRepository(std::istream& archiveFile, const ACFHeader& header,
+                                                           const std::string& archivePath)
+  {
+    namespace fs = std::filesystem;
+    std::string repositoryPath = m_RepositoryPath;
+    if (repositoryPath.empty()) {
+        if (!(header.flags & ACF_FLAG_REPOSITORY)) {
+            throw std::runtime_error("Archive has chunk entries but no repository record: " + archivePath);
+        }
+        ACFRepositoryRecord record{};
+        archiveFile.clear();
+        archiveFile.seekg(sizeof(ACFHeader));
+        archiveFile.read(reinterpret_cast<char*>(&record), sizeof(record));
+        std::string recorded(record.pathLength, '\0');
+        archiveFile.read(recorded.data(), recorded.size());
+        if (!archiveFile) {
+            throw std::runtime_error("Could not read repository record of archive: " + archivePath);
+        }
+        repositoryPath = detail::RecordedRepositoryPath(recorded, archivePath);
+    }
+    if (!m_Repository || m_Repository->Path() != repositoryPath) {
+        m_Repository = detail::ChunkRepository::Open(repositoryPath, false, false);
+    }
+    return *m_Repository;
+  }
+
+  struct ACFArchiver::BaseArchive
+  {
+    std::string path;
+    std::filesystem::file_time_type modified;
+    uint64_t size = 0;
+    ACFArchiver reader;
+    std::ifstream file;
+    ACFHeader header;
+    std::unordered_map<std::string, ACFEntryData> files;
+  };
+
+  ACFArchiver::BaseArchive& ACFArchiver::OpenBase(const std::string& basePath)
+  {
+    namespace fs = std::filesystem;
+    const fs::file_time_type modified = fs::last_write_time(basePath);
+    const uint64_t size = fs::file_size(basePath);
+    if (m_Base && m_Base->path == basePath && m_Base->modified == modified && m_Base->size == size) {
+        return *m_Base;
+    }
+    auto base = std::make_shared<BaseArchive>();
+    base->path = basePath;
+    base->modified = modified;
+    base->size = size;
+    base->reader.SetDecoderMemoryLimit(m_DecoderMemoryLimit);
+    base->file.open(basePath, std::ios::binary);
+    base->file.read(reinterpret_cast<char*>(&base->header), sizeof(ACFHeader));
+    if (!base->file || base->header.magic != ACF_MAGIC) {
+        throw std::runtime_error("Not a valid ACF base archive: " + basePath);
+    }
+    for (const auto& [entry, path] : base->reader.List(basePath)) {
+        if (entry.type == EntryType::File) base->files.emplace(path, entry);
+    }
+    m_Base = std::move(base);
+    return *m_Base;
+  }
+
   void ACFArchiver::Create(const std::string& archivePath, 
               const std::vector<std::string>& inputPaths,
               const std::string& basePath,
               const std::string& internalBasePath)
+  {
+    WriteArchive(archivePath, inputPaths, nullptr, basePath, internalBasePath);
+  }
+
+  void ACFArchiver::CreateFromList(const std::string& archivePath,
+              const std::function<bool(std::string& path)>& nextPath,
+              const std::string& basePath,
+              const std::string& internalBasePath)
+  {
+    // Everything here needs the whole input list before the first file is stored.
+    if (m_Profile.order != FileOrder::Path || !m_Profile.layoutProfile.empty() || m_Profile.frontIndex ||
+        m_Profile.readOrder != ReadOrder::Path || (m_Profile.adaptive && m_Profile.deadlineSeconds > 0)) {
+        throw std::runtime_error("A streamed file list needs path order and no layout profile, front index, read order or deadline.");
+    }
+    WriteArchive(archivePath, {}, nextPath, basePath, internalBasePath);
+  }
+
+  void ACFArchiver::WriteArchive(const std::string& archivePath,
+              const std::vector<std::string>& inputPaths,
+              const std::function<bool(std::string& path)>& nextPath,
+              const std::string& basePath,
+              const std::string& internalBasePath)
   {
     namespace fs = std::filesystem;
+    const bool streamed = static_cast<bool>(nextPath);
 
     std::ofstream archiveFile(archivePath, std::ios::binary | std::ios::trunc);
     if (!archiveFile) {
@@ -105,149 +737,445 @@ namespace acf
     ACFHeader header;
     archiveFile.write(reinterpret_cast<const char*>(&header), sizeof(ACFHeader)); // Placeholder
 
+    // Delta archive: files whose path is also in the base are compressed with
+    // the base version as prefix. The base is identified by name, central
+    // directory CRC and size.
+    BaseArchive* base = nullptr;
+    if (!m_BaseArchivePath.empty()) {
+        base = &OpenBase(m_BaseArchivePath);
+
+        const std::string baseName = platform::ToInternalPath(fs::path(m_BaseArchivePath).filename());
+        ACFBaseRecord record{};
+        record.centralDirCRC32 = base->header.centralDirCRC32;
+        record.archiveSize = base->size;
+        record.nameLength = static_cast<uint16_t>(baseName.size());
+        archiveFile.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        archiveFile.write(baseName.data(), baseName.size());
+        header.flags |= ACF_FLAG_BASE;
+    }
+
+    // Repository mode: the archive becomes a manifest of chunk references and
+    // records where the repository is, relative to the archive when possible.
+    detail::ChunkRepository* repository = nullptr;
+    if (!m_RepositoryPath.empty()) {
+        if (header.flags & ACF_FLAG_BASE) {
+            throw std::runtime_error("A manifest cannot also be a delta archive.");
+        }
+        if (!m_Repository || m_Repository->Path() != m_RepositoryPath) {
+            m_Repository = detail::ChunkRepository::Open(m_RepositoryPath, true, true);
+        }
+        repository = m_Repository.get();
+
+        const fs::path archiveDir = fs::absolute(archivePath).parent_path();
+        const std::string recorded = platform::ToInternalPath(fs::proximate(fs::absolute(m_RepositoryPath), archiveDir));
+        ACFRepositoryRecord record{};
+        record.pathLength = static_cast<uint16_t>(recorded.size());
+        archiveFile.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        archiveFile.write(recorded.data(), recorded.size());
+        header.flags |= ACF_FLAG_REPOSITORY;
+    }
+
+    const uint32_t alignment = m_Profile.alignment;
+    if (!m_Profile.storeAligned.empty() && (alignment == 0 || (alignment & (alignment - 1)))) {
+        throw std::runtime_error("Alignment must be a power of two: " + std::to_string(alignment));
+    }
+
     std::vector<ACFEntryData> centralDirectory;
     std::vector<std::string> pathStrings;
     
     fs::path fsBasePath(basePath);
-    std::unordered_set<fs::path> processedPaths;
-
     std::vector<fs::path> filesToProcess;
     std::vector<fs::path> dirsToProcess;
-
-    for (const auto& inputPathStr : inputPaths) {
-        fs::path inputPath(inputPathStr);
-        if (!fs::exists(inputPath) || processedPaths.count(inputPath)) continue;
-
-        if (fs::is_directory(inputPath)) {
-            if (processedPaths.find(inputPath) == processedPaths.end()) {
-                dirsToProcess.push_back(inputPath);
-                processedPaths.insert(inputPath);
-            }
-            for (const auto& dir_entry : fs::recursive_directory_iterator(inputPath)) {
-                 if (processedPaths.count(dir_entry.path())) continue;
-                if (dir_entry.is_directory()) {
-                    dirsToProcess.push_back(dir_entry.path());
-                } else if (dir_entry.is_regular_file()) {
-                    filesToProcess.push_back(dir_entry.path());
-                }
-                processedPaths.insert(dir_entry.path());
-            }
-        } else if (fs::is_regular_file(inputPath)) {
-            filesToProcess.push_back(inputPath);
-            processedPaths.insert(inputPath);
-        }
-    }
-    
-    std::sort(dirsToProcess.begin(), dirsToProcess.end());
-    std::sort(filesToProcess.begin(), filesToProcess.end());
+    detail::CollectInputs(inputPaths, filesToProcess, dirsToProcess, m_Profile);
 
     for (const auto& dirPath : dirsToProcess) {
-        fs::path relativePath = fs::relative(dirPath, fsBasePath);
-        fs::path internalPath_fs = fs::path(internalBasePath) / relativePath;
-        std::string internalPath = WStringToString(internalPath_fs.make_preferred().wstring());
-        if (!internalPath.empty() && internalPath.back() != '\\') {
-            internalPath += '\\';
-        }
+        std::string internalPath = detail::InternalPathFor(dirPath, fsBasePath, internalBasePath, true);
 
         ACFEntryData dirEntry{};
         dirEntry.type = EntryType::Directory;
-        
-        auto ftime = fs::last_write_time(dirPath);
-        ULARGE_INTEGER uli;
-        uli.QuadPart = ftime.time_since_epoch().count();
-        FILETIME ft;
-        ft.dwLowDateTime = uli.LowPart;
-        ft.dwHighDateTime = uli.HighPart;
-        dirEntry.filedatetime = FileTimeToDosDateTime(ft);
-        
-        dirEntry.fileattribute = GetFileAttributesW(dirPath.c_str());
+
+        platform::FileInfo info;
+        platform::Stat(dirPath, info);
+        dirEntry.filedatetime = info.dosDateTime;
+        dirEntry.fileattribute = info.attributes;
+        dirEntry.unixMode = info.unixMode;
         dirEntry.pathLength = static_cast<uint16_t>(internalPath.length());
         
         centralDirectory.push_back(dirEntry);
         pathStrings.push_back(internalPath);
     }
 
-    float totalFiles = filesToProcess.size();
+    // Front index: room for the directory is reserved here and filled in at
+    // the end; every entry and path length is known already. Files that
+    // cannot be opened later only leave unused room.
+    uint64_t frontIndexOffset = 0;
+    if (m_Profile.frontIndex) {
+        uint64_t reserved = sizeof(uint64_t);
+        for (const auto& path : pathStrings) reserved += sizeof(ACFEntryData) + path.size();
+        for (const auto& filePath : filesToProcess) {
+            reserved += sizeof(ACFEntryData) + detail::InternalPathFor(filePath, fsBasePath, internalBasePath, false).size();
+        }
+        std::vector<char> zeros(reserved);
+        archiveFile.write(zeros.data(), zeros.size());
+        frontIndexOffset = static_cast<uint64_t>(archiveFile.tellp()) - reserved + sizeof(uint64_t);
+        header.flags |= ACF_FLAG_FRONT_INDEX;
+    }
+
+    uint64_t totalInputBytes = 0;
+    if (m_Profile.adaptive && m_Profile.deadlineSeconds > 0) {
+        for (const auto& filePath : filesToProcess) {
+            platform::FileInfo info;
+            if (platform::Stat(filePath, info)) totalInputBytes += info.size;
+        }
+    }
+    LevelController levelController(m_Profile, totalInputBytes);
+
+    float totalFiles = filesToProcess.size(); // 0 when streamed: no overall progress
     float filesProcessed = 0;
+    platform::FileReader inputFile;
 
-    for (const auto& filePath : filesToProcess) {
-        fs::path relativePath = fs::relative(filePath, fsBasePath);
-        fs::path internalPath_fs = fs::path(internalBasePath) / relativePath;
-        std::string internalPath = WStringToString(internalPath_fs.make_preferred().wstring());
+    ZSTD_CStream_Ptr cstream(ZSTD_createCStream());
+    if (!cstream) { throw std::runtime_error("ZSTD_createCStream() error"); }
+    std::vector<char> inBuff(ZSTD_CStreamInSize());
+    std::vector<char> outBuff(ZSTD_CStreamOutSize());
+    bool rolledBack = false; // A failed passthrough may leave bytes past the final end
+
+    // Similar files are stored together; the first file of a group that fits
+    // kMaxPrefix is kept in memory and referenced as prefix by the rest.
+    const size_t dirEntryCount = centralDirectory.size();
+    std::vector<detail::OrderedInput> order = detail::OrderInputs(filesToProcess, m_Profile.order);
+    const bool usePrefix = m_Profile.order != FileOrder::Path;
+    // Files of the layout profile go first, in profile order, each in a group
+    // of its own so that none depends on a file stored after it.
+    if (!m_Profile.layoutProfile.empty()) {
+        std::unordered_map<std::string, size_t> rank;
+        for (const auto& path : m_Profile.layoutProfile) rank.emplace(NormalizeInternalPath(path), rank.size());
+        std::vector<size_t> fileRank(filesToProcess.size(), SIZE_MAX);
+        for (size_t i = 0; i < filesToProcess.size(); ++i) {
+            auto it = rank.find(detail::InternalPathFor(filesToProcess[i], fsBasePath, internalBasePath, false));
+            if (it != rank.end()) fileRank[i] = it->second;
+        }
+        size_t groups = 0;
+        for (const auto& item : order) groups = std::max(groups, item.group + 1);
+        std::stable_partition(order.begin(), order.end(), [&](const detail::OrderedInput& item) { return fileRank[item.index] != SIZE_MAX; });
+        auto cold = std::find_if(order.begin(), order.end(), [&](const detail::OrderedInput& item) { return fileRank[item.index] == SIZE_MAX; });
+        std::sort(order.begin(), cold, [&](const detail::OrderedInput& a, const detail::OrderedInput& b) { return fileRank[a.index] < fileRank[b.index]; });
+        for (auto it = order.begin(); it != cold; ++it) it->group = groups + fileRank[it->index];
+    }
+    const bool reordered = usePrefix || !m_Profile.layoutProfile.empty();
+    // Inputs are fetched from disk ahead of time in disk order; the order
+    // they are stored in stays the one computed above.
+    std::unique_ptr<detail::ReadAhead> readAhead;
+    if (m_Profile.readOrder != ReadOrder::Path) {
+        std::vector<fs::path> sequence;
+        sequence.reserve(order.size());
+        for (const auto& item : order) sequence.push_back(filesToProcess[item.index]);
+        readAhead = std::make_unique<detail::ReadAhead>(std::move(sequence), m_Profile.readOrder, m_Profile.readAheadBytes);
+    }
+    std::vector<size_t> storedOrder;
+    size_t currentGroup = SIZE_MAX;
+    std::vector<uint8_t> prefix;
+    uint64_t prefixOffset = 0;
+
+    // A streamed list is stored in arrival order, one path at a time.
+    std::string streamedPath;
+    for (size_t position = 0;; ++position) {
+        detail::OrderedInput item{ position, position };
+        if (streamed) {
+            if (!nextPath(streamedPath)) break;
+            if (streamedPath.empty()) continue;
+        } else {
+            if (position == order.size()) break;
+            item = order[position];
+        }
+        const fs::path filePath = streamed ? fs::path(streamedPath) : filesToProcess[item.index];
+        if (readAhead) readAhead->Advance(position);
+        if (item.group != currentGroup) {
+            currentGroup = item.group;
+            prefix.clear();
+            prefixOffset = 0;
+        }
+        std::string internalPath = detail::InternalPathFor(filePath, fsBasePath, internalBasePath, false);
 
         if (m_CallbackFunc) {
-            m_CallbackFunc(internalPath, 0.0f, filesProcessed / totalFiles);
+            m_CallbackFunc(internalPath, 0.0f, streamed ? 0.0f : filesProcessed / totalFiles);
+        }
+
+        platform::FileInfo info;
+        const bool opened = inputFile.Open(filePath, info);
+        // Streamed paths are taken as they are: a directory is stored, not
+        // walked, and anything but a regular file or directory is skipped.
+        if (streamed && info.directory) {
+            inputFile.Close();
+            ACFEntryData dirEntry{};
+            dirEntry.type = EntryType::Directory;
+            dirEntry.filedatetime = info.dosDateTime;
+            dirEntry.fileattribute = info.attributes;
+            dirEntry.unixMode = info.unixMode;
+            internalPath = detail::InternalPathFor(filePath, fsBasePath, internalBasePath, true);
+            dirEntry.pathLength = static_cast<uint16_t>(internalPath.length());
+            centralDirectory.push_back(dirEntry);
+            pathStrings.push_back(internalPath);
+            continue;
+        }
+        if (!opened) continue;
+        if (streamed && !info.regular) {
+            inputFile.Close();
+            continue;
         }
 
         ACFEntryData fileEntry{};
         fileEntry.type = EntryType::File;
-        fileEntry.originalSize = fs::file_size(filePath);
+        fileEntry.originalSize = info.size;
         fileEntry.dataOffset = archiveFile.tellp();
-        
-        FILETIME ft;
-        WIN32_FILE_ATTRIBUTE_DATA fad;
-        if (GetFileAttributesExW(filePath.generic_wstring().c_str(), GetFileExInfoStandard, &fad))
-        {
-            ft = fad.ftLastWriteTime;
-        }
-        else
-        {
-            ft.dwLowDateTime = ft.dwHighDateTime = 0;
-        }
-        fileEntry.filedatetime = FileTimeToDosDateTime(ft);
-        fileEntry.fileattribute = GetFileAttributesW(filePath.c_str());
+        fileEntry.filedatetime = info.dosDateTime;
+        fileEntry.fileattribute = info.attributes;
+        fileEntry.unixMode = info.unixMode;
         fileEntry.pathLength = static_cast<uint16_t>(internalPath.length());
 
-        std::ifstream inputFile(filePath, std::ios::binary);
-        if (!inputFile) continue;
+        // Selected files are stored as they are at an aligned offset, for
+        // readers that map the archive and use the bytes in place.
+        const bool aligned = std::any_of(m_Profile.storeAligned.begin(), m_Profile.storeAligned.end(),
+                                         [&](const std::string& pattern) { return detail::GlobMatch(pattern, internalPath); });
+        if (aligned) {
+            const uint64_t padding = (alignment - fileEntry.dataOffset % alignment) % alignment;
+            std::fill(outBuff.begin(), outBuff.end(), 0);
+            for (uint64_t left = padding; left > 0;) {
+                const size_t n = static_cast<size_t>(std::min<uint64_t>(left, outBuff.size()));
+                archiveFile.write(outBuff.data(), n);
+                left -= n;
+            }
+            fileEntry.dataOffset += padding;
+
+            uint32_t crc = 0;
+            uint64_t totalBytesRead = 0;
+            while (size_t readCount = inputFile.Read(inBuff.data(), inBuff.size())) {
+                crc = crc32_update(crc, inBuff.data(), readCount);
+                totalBytesRead += readCount;
+                archiveFile.write(inBuff.data(), readCount);
+                levelController.Update(readCount);
+            }
+            inputFile.Close();
+
+            fileEntry.method = CompressionMethod::Uncompressed;
+            fileEntry.crc32 = crc;
+            fileEntry.originalSize = totalBytesRead;
+            fileEntry.compressedSize = totalBytesRead;
+            centralDirectory.push_back(fileEntry);
+            pathStrings.push_back(internalPath);
+            storedOrder.push_back(item.index);
+            filesProcessed++;
+            if (m_CallbackFunc) {
+                m_CallbackFunc(internalPath, 1.0f, streamed ? 0.0f : filesProcessed / totalFiles);
+            }
+            continue;
+        }
 
-        ZSTD_CStream_Ptr cstream(ZSTD_createCStream());
-        ZSTD_initCStream(cstream.get(), 9);
-        
-        size_t const inBuffSize = ZSTD_CStreamInSize();
-        std::vector<char> inBuff(inBuffSize);
-        size_t const outBuffSize = ZSTD_CStreamOutSize();
-        std::vector<char> outBuff(outBuffSize);
+        if (repository) {
+            detail::Chunker chunker;
+            std::vector<detail::ChunkRef> refs;
+            auto store = [&](const uint8_t* data, size_t size) {
+                refs.push_back(repository->Put(data, size, levelController.Level()));
+            };
+            uint32_t crc = 0;
+            uint64_t totalBytesRead = 0;
+            while (size_t readCount = inputFile.Read(inBuff.data(), inBuff.size())) {
+                crc = crc32_update(crc, inBuff.data(), readCount);
+                totalBytesRead += readCount;
+                chunker.Feed(reinterpret_cast<const uint8_t*>(inBuff.data()), readCount, store);
+                levelController.Update(readCount);
+            }
+            chunker.Finish(store);
+            inputFile.Close();
+
+            fileEntry.method = CompressionMethod::ChunkRef;
+            fileEntry.crc32 = crc;
+            fileEntry.originalSize = totalBytesRead;
+            fileEntry.compressedSize = refs.size() * sizeof(detail::ChunkRef);
+            archiveFile.write(reinterpret_cast<const char*>(refs.data()), fileEntry.compressedSize);
+            centralDirectory.push_back(fileEntry);
+            pathStrings.push_back(internalPath);
+            storedOrder.push_back(item.index);
+            filesProcessed++;
+            if (m_CallbackFunc) {
+                m_CallbackFunc(internalPath, 1.0f, streamed ? 0.0f : filesProcessed / totalFiles);
+            }
+            continue;
+        }
 
-        uint64_t totalCompressedSize = 0;
-        uint32_t crc = 0;
-        for (;;) {
-            inputFile.read(inBuff.data(), inBuff.size());
-            size_t readCount = inputFile.gcount();
-            if (readCount == 0) break;
+        if (m_Profile.zstdPassthrough) {
+            bool wroteAny = false;
+            if (CopyZstdPassthrough(inputFile, archiveFile, inBuff, fileEntry, wroteAny)) {
+                inputFile.Close();
+                levelController.Update(fileEntry.compressedSize);
+                centralDirectory.push_back(fileEntry);
+                pathStrings.push_back(internalPath);
+                storedOrder.push_back(item.index);
+                filesProcessed++;
+                if (m_CallbackFunc) {
+                    m_CallbackFunc(internalPath, 1.0f, streamed ? 0.0f : filesProcessed / totalFiles);
+                }
+                continue;
+            }
+            if (wroteAny) {
+                archiveFile.seekp(fileEntry.dataOffset);
+                rolledBack = true;
+            }
+            inputFile.Rewind();
+        }
 
-            crc = crc32_update(crc, inBuff.data(), readCount);
+        std::vector<uint8_t> baseContent;
+        const ACFEntryData* baseEntry = nullptr;
+        if (base) {
+            auto baseIt = base->files.find(internalPath);
+            if (baseIt != base->files.end()) baseEntry = &baseIt->second;
+        }
+        if (baseEntry) {
+            const uint64_t baseSize = baseEntry->method == CompressionMethod::ZstdPassthrough ? baseEntry->compressedSize : baseEntry->originalSize;
+            const int windowLog = PatchWindowLog(m_Profile, baseSize, info.size);
+            if (baseSize > 0 && windowLog > 0) {
+                baseContent = base->reader.ExtractEntryData(base->file, base->header, m_BaseArchivePath, *baseEntry, internalPath);
+                fileEntry.method = CompressionMethod::ZstdPatch;
+                fileEntry.windowLog = static_cast<uint8_t>(windowLog);
+            }
+        }
+        if (fileEntry.method != CompressionMethod::ZstdPatch) {
+            fileEntry.windowLog = static_cast<uint8_t>(LongRangeWindowLog(m_Profile, info.size));
+        }
+        StartFrame(cstream.get(), levelController.Level(), m_Profile.strategy, fileEntry.windowLog);
+        if (fileEntry.method == CompressionMethod::ZstdPatch) {
+            ZSTD_CCtx_refPrefix(cstream.get(), baseContent.data(), baseContent.size());
+        } else if (prefixOffset) {
+            ZSTD_CCtx_refPrefix(cstream.get(), prefix.data(), prefix.size());
+            fileEntry.prefixOffset = prefixOffset;
+        }
+        bool capture = usePrefix && !prefixOffset && fileEntry.method == CompressionMethod::Zstd &&
+                       info.size > 0 && info.size <= kMaxPrefix;
 
-            ZSTD_inBuffer inBuffer = { inBuff.data(), readCount, 0 };
+        uint64_t totalCompressedSize = 0;
+        uint64_t totalBytesRead = 0;
+        uint32_t crc = 0;
+        bool frameOpen = true;
+        std::unique_ptr<detail::Filter> filter;
+        std::vector<uint8_t> filtered;
+        auto compress = [&](const void* data, size_t size) {
+            ZSTD_inBuffer inBuffer = { data, size, 0 };
+            if (size) frameOpen = true;
             while (inBuffer.pos < inBuffer.size) {
                 ZSTD_outBuffer outBuffer = { outBuff.data(), outBuff.size(), 0 };
                 ZSTD_compressStream(cstream.get(), &outBuffer, &inBuffer);
                 archiveFile.write(outBuff.data(), outBuffer.pos);
                 totalCompressedSize += outBuffer.pos;
             }
+        };
+        for (;;) {
+            size_t readCount = inputFile.Read(inBuff.data(), inBuff.size());
+            if (readCount == 0) break;
+
+            // The filter is chosen from the first chunk of the file. Patched and
+            // prefixed entries are not filtered, and a filtered file is not kept
+            // as prefix: a base or prefix is referenced as raw content.
+            if (totalBytesRead == 0 && m_Profile.filters && fileEntry.method != CompressionMethod::ZstdPatch &&
+                !fileEntry.prefixOffset) {
+                fileEntry.filter = detail::SniffFilter(reinterpret_cast<const uint8_t*>(inBuff.data()), readCount, fileEntry.filterParam);
+                filter = detail::CreateFilter(fileEntry.filter, fileEntry.filterParam, true);
+                if (filter) capture = false;
+            }
+
+            totalBytesRead += readCount;
+            crc = crc32_update(crc, inBuff.data(), readCount);
+            if (capture) prefix.insert(prefix.end(), inBuff.data(), inBuff.data() + readCount);
+
+            if (filter) {
+                filtered.clear();
+                filter->Process(reinterpret_cast<const uint8_t*>(inBuff.data()), readCount, false, filtered);
+                compress(filtered.data(), filtered.size());
+            } else {
+                compress(inBuff.data(), readCount);
+            }
+
+            // A new level only takes effect on a new frame; entries may hold several.
+            // A prefix only primes the first frame, so patched and prefixed entries
+            // keep their level and pick up the new one with the next file.
+            if (levelController.Update(readCount) && fileEntry.method != CompressionMethod::ZstdPatch &&
+                !fileEntry.prefixOffset) {
+                totalCompressedSize += EndFrame(cstream.get(), outBuff, archiveFile);
+                ZSTD_CCtx_setParameter(cstream.get(), ZSTD_c_compressionLevel, levelController.Level());
+                frameOpen = false;
+            }
         }
 
-        ZSTD_outBuffer outBuffer = { outBuff.data(), outBuff.size(), 0 };
-        size_t const remaining = ZSTD_endStream(cstream.get(), &outBuffer);
-        if (ZSTD_isError(remaining)) {
-            throw std::runtime_error("ZSTD_endStream error");
+        if (filter) {
+            filtered.clear();
+            filter->Process(nullptr, 0, true, filtered);
+            compress(filtered.data(), filtered.size());
+        }
+        if (frameOpen) {
+            totalCompressedSize += EndFrame(cstream.get(), outBuff, archiveFile);
         }
-        archiveFile.write(outBuff.data(), outBuffer.pos);
-        totalCompressedSize += outBuffer.pos;
         
+        inputFile.Close();
+
         fileEntry.crc32 = crc;
+        fileEntry.originalSize = totalBytesRead;
         fileEntry.compressedSize = totalCompressedSize;
         centralDirectory.push_back(fileEntry);
         pathStrings.push_back(internalPath);
+        storedOrder.push_back(item.index);
+        if (capture) {
+            if (!prefix.empty() && prefix.size() <= kMaxPrefix) prefixOffset = fileEntry.dataOffset;
+            else prefix.clear();
+        }
 
         filesProcessed++;
         if (m_CallbackFunc) {
-            m_CallbackFunc(internalPath, 1.0f, filesProcessed / totalFiles);
+            m_CallbackFunc(internalPath, 1.0f, streamed ? 0.0f : filesProcessed / totalFiles);
         }
     }
 
-    header.centralDirOffset = archiveFile.tellp();
+    // Chunks must be durable before a manifest refers to them.
+    if (repository) repository->Commit();
+
+    // The central directory stays in path order whatever the storage order was.
+    if (reordered) {
+        std::vector<size_t> slots(storedOrder.size());
+        std::iota(slots.begin(), slots.end(), 0);
+        std::sort(slots.begin(), slots.end(), [&](size_t a, size_t b) { return storedOrder[a] < storedOrder[b]; });
+        std::vector<ACFEntryData> sortedEntries;
+        std::vector<std::string> sortedPaths;
+        for (size_t slot : slots) {
+            sortedEntries.push_back(centralDirectory[dirEntryCount + slot]);
+            sortedPaths.push_back(std::move(pathStrings[dirEntryCount + slot]));
+        }
+        std::copy(sortedEntries.begin(), sortedEntries.end(), centralDirectory.begin() + dirEntryCount);
+        std::move(sortedPaths.begin(), sortedPaths.end(), pathStrings.begin() + dirEntryCount);
+    }
+    // A streamed list arrives in any order and may repeat paths: directories
+    // go first, then files, each by path, and only the first copy of a
+    // repeated path is listed.
+    if (streamed) {
+        std::vector<size_t> slots(centralDirectory.size());
+        std::iota(slots.begin(), slots.end(), 0);
+        std::stable_sort(slots.begin(), slots.end(), [&](size_t a, size_t b) {
+            const bool aFile = centralDirectory[a].type != EntryType::Directory;
+            const bool bFile = centralDirectory[b].type != EntryType::Directory;
+            return aFile != bFile ? bFile : pathStrings[a] < pathStrings[b];
+        });
+        slots.erase(std::unique(slots.begin(), slots.end(), [&](size_t a, size_t b) { return pathStrings[a] == pathStrings[b]; }),
+                    slots.end());
+        std::vector<ACFEntryData> sortedEntries;
+        std::vector<std::string> sortedPaths;
+        for (size_t slot : slots) {
+            sortedEntries.push_back(centralDirectory[slot]);
+            sortedPaths.push_back(std::move(pathStrings[slot]));
+        }
+        centralDirectory = std::move(sortedEntries);
+        pathStrings = std::move(sortedPaths);
+    }
+
+    header.centralDirOffset = m_Profile.frontIndex ? frontIndexOffset : static_cast<uint64_t>(archiveFile.tellp());
     header.entryCount = centralDirectory.size();
+    header.entrySize = sizeof(ACFEntryData);
     
     std::vector<char> centralDirBuffer;
     for (size_t i = 0; i < centralDirectory.size(); ++i) {
@@ -255,12 +1183,23 @@ namespace acf
         centralDirBuffer.insert(centralDirBuffer.end(), entry_ptr, entry_ptr + sizeof(ACFEntryData));
         centralDirBuffer.insert(centralDirBuffer.end(), pathStrings[i].begin(), pathStrings[i].end());
     }
+    const uint64_t archiveEnd = static_cast<uint64_t>(archiveFile.tellp()) + (m_Profile.frontIndex ? 0 : centralDirBuffer.size());
+    if (m_Profile.frontIndex) {
+        const uint64_t centralDirSize = centralDirBuffer.size();
+        archiveFile.seekp(frontIndexOffset - sizeof(uint64_t));
+        archiveFile.write(reinterpret_cast<const char*>(&centralDirSize), sizeof(centralDirSize));
+    }
     archiveFile.write(centralDirBuffer.data(), centralDirBuffer.size());
 
     header.centralDirCRC32 = crc32(centralDirBuffer.data(), centralDirBuffer.size());
 
     archiveFile.seekp(0);
     archiveFile.write(reinterpret_cast<const char*>(&header), sizeof(ACFHeader));
+    archiveFile.close();
+    if (repository) repository->RegisterManifest(archivePath);
+    if (rolledBack) {
+        fs::resize_file(archivePath, archiveEnd);
+    }
 
     if (m_CallbackFunc) {
         m_CallbackFunc("Done.", 1.0f, 1.0f);
@@ -280,16 +1219,28 @@ namespace acf
     archiveFile.write(reinterpret_cast<const char*>(&header), sizeof(ACFHeader));
 
     const uint64_t dataOffset = archiveFile.tellp();
+    const std::string storedPath = NormalizeInternalPath(internalPath);
 
     ZSTD_CStream_Ptr cstream(ZSTD_createCStream());
     if (!cstream) { throw std::runtime_error("ZSTD_createCStream() error"); }
-    if (ZSTD_isError(ZSTD_initCStream(cstream.get(), 9))) {
-        throw std::runtime_error("ZSTD_initCStream() error");
+    const int windowLog = LongRangeWindowLog(m_Profile, data.size());
+    StartFrame(cstream.get(), m_Profile.level, m_Profile.strategy, windowLog);
+
+    FilterType filterType = FilterType::None;
+    uint8_t filterParam = 0;
+    std::vector<uint8_t> filtered;
+    if (m_Profile.filters && !data.empty()) {
+        filterType = detail::SniffFilter(data.data(), data.size(), filterParam);
+        if (auto filter = detail::CreateFilter(filterType, filterParam, true)) {
+            filtered.reserve(data.size());
+            filter->Process(data.data(), data.size(), true, filtered);
+        }
     }
+    const std::vector<uint8_t>& source = filterType != FilterType::None ? filtered : data;
 
     size_t const cBuffSize = ZSTD_CStreamOutSize();
     std::vector<char> cBuff(cBuffSize);
-    ZSTD_inBuffer inBuff = { data.data(), data.size(), 0 };
+    ZSTD_inBuffer inBuff = { source.data(), source.size(), 0 };
     
     uint64_t compressedSize = 0;
     while (inBuff.pos < inBuff.size) {
@@ -301,12 +1252,7 @@ namespace acf
         compressedSize += outBuff.pos;
     }
 
-    ZSTD_outBuffer outBuff = { cBuff.data(), cBuff.size(), 0 };
-    if (ZSTD_isError(ZSTD_endStream(cstream.get(), &outBuff))) {
-        throw std::runtime_error("ZSTD_endStream() error");
-    }
-    archiveFile.write(cBuff.data(), outBuff.pos);
-    compressedSize += outBuff.pos;
+    compressedSize += EndFrame(cstream.get(), cBuff, archiveFile);
     
     ACFEntryData entryData{};
     entryData.type = EntryType::File;
@@ -314,20 +1260,22 @@ namespace acf
     entryData.compressedSize = compressedSize;
     entryData.dataOffset = dataOffset;
     entryData.crc32 = crc32(data.data(), data.size());
+    entryData.windowLog = static_cast<uint8_t>(windowLog);
+    entryData.filter = filterType;
+    entryData.filterParam = filterParam;
     
-    FILETIME ft;
-    GetSystemTimeAsFileTime(&ft);
-    entryData.filedatetime = FileTimeToDosDateTime(ft);
-    entryData.fileattribute = FILE_ATTRIBUTE_ARCHIVE;
-    entryData.pathLength = static_cast<uint16_t>(internalPath.length());
+    entryData.filedatetime = platform::CurrentDosDateTime();
+    entryData.fileattribute = ATTR_ARCHIVE;
+    entryData.pathLength = static_cast<uint16_t>(storedPath.length());
 
     header.centralDirOffset = archiveFile.tellp();
     header.entryCount = 1;
+    header.entrySize = sizeof(ACFEntryData);
 
     std::vector<char> centralDirBuffer;
     const char* entry_ptr = reinterpret_cast<const char*>(&entryData);
     centralDirBuffer.insert(centralDirBuffer.end(), entry_ptr, entry_ptr + sizeof(ACFEntryData));
-    centralDirBuffer.insert(centralDirBuffer.end(), internalPath.begin(), internalPath.end());
+    centralDirBuffer.insert(centralDirBuffer.end(), storedPath.begin(), storedPath.end());
     
     archiveFile.write(centralDirBuffer.data(), centralDirBuffer.size());
     header.centralDirCRC32 = crc32(centralDirBuffer.data(), centralDirBuffer.size());
@@ -340,51 +1288,7 @@ namespace acf
                   const std::string& outputPath)
   {
     auto entries = List(archivePath); // List() also validates the archive
-    
-    namespace fs = std::filesystem;
-    fs::path outputDir(outputPath);
-    float totalEntries = entries.size();
-    float entriesProcessed = 0;
-
-    for (const auto& pair : entries) {
-        const auto& entry = pair.first;
-        const auto& path = pair.second;
-        fs::path fullPath = outputDir / fs::path(path);
-
-        if (m_CallbackFunc) {
-            m_CallbackFunc(path, 0.0f, entriesProcessed / totalEntries);
-        }
-
-        if (entry.type == EntryType::Directory) {
-            fs::create_directories(fullPath);
-        } else if (entry.type == EntryType::File) {
-            fs::create_directories(fullPath.parent_path());
-            
-            std::vector<uint8_t> data = ExtractData(archivePath, path); // CRC is checked inside
-            std::ofstream outputFile(fullPath, std::ios::binary | std::ios::trunc);
-            if (outputFile) {
-                outputFile.write(reinterpret_cast<const char*>(data.data()), data.size());
-            }
-        }
-
-        // Set attributes and time
-        FILETIME ft = DosDateTimeToFileTime(entry.filedatetime);
-        ULARGE_INTEGER uli;
-        uli.LowPart = ft.dwLowDateTime;
-        uli.HighPart = ft.dwHighDateTime;
-        auto ftime = std::filesystem::file_time_type(std::filesystem::file_time_type::duration(uli.QuadPart));
-        std::error_code ec;
-        fs::last_write_time(fullPath, ftime, ec); // Ignore error
-        SetFileAttributesW(fullPath.c_str(), entry.fileattribute);
-
-        entriesProcessed++;
-        if (m_CallbackFunc) {
-            m_CallbackFunc(path, 1.0f, entriesProcessed / totalEntries);
-        }
-    }
-    if (m_CallbackFunc) {
-        m_CallbackFunc("Done.", 1.0f, 1.0f);
-    }
+    ExtractEntries(archivePath, entries, outputPath);
   }
 
   void ACFArchiver::Extract(const std::string& archivePath,
@@ -392,9 +1296,10 @@ namespace acf
               const std::string& outputPath)
   {
     auto allEntries = List(archivePath);
-    std::unordered_set<std::string> filesToExtractSet(archFileNames.begin(), archFileNames.end());
-    namespace fs = std::filesystem;
-    fs::path outputDir(outputPath);
+    std::unordered_set<std::string> filesToExtractSet;
+    for (const auto& name : archFileNames) {
+        filesToExtractSet.insert(NormalizeInternalPath(name));
+    }
 
     std::vector<std::pair<ACFEntryData, std::string>> entriesToExtract;
     for(const auto& pair : allEntries) {
@@ -403,13 +1308,55 @@ namespace acf
         }
     }
 
-    float totalEntries = entriesToExtract.size();
+    ExtractEntries(archivePath, entriesToExtract, outputPath);
+  }
+
+  void ACFArchiver::ExtractEntries(const std::string& archivePath,
+              const std::vector<std::pair<ACFEntryData, std::string>>& entries,
+              const std::string& outputPath)
+  {
+    namespace fs = std::filesystem;
+    // Checked before anything is written, so a hostile archive extracts nothing.
+    for (const auto& pair : entries) {
+        if (!detail::IsSafeInternalPath(pair.second)) {
+            throw std::runtime_error("Archive entry leaves the output directory: " + pair.second);
+        }
+    }
+
+    std::ifstream archiveFile(archivePath, std::ios::binary);
+    ACFHeader header;
+    archiveFile.read(reinterpret_cast<char*>(&header), sizeof(ACFHeader));
+    if (!archiveFile || header.magic != ACF_MAGIC) {
+        throw std::runtime_error("Not a valid ACF archive: " + archivePath);
+    }
+
+    fs::path outputDir(outputPath);
+    float totalEntries = entries.size();
     float entriesProcessed = 0;
 
-    for (const auto& pair : entriesToExtract) {
+    // Directory metadata is applied last: extracting children would bump the
+    // mtime again, and a read-only directory could not receive them.
+    std::vector<std::pair<fs::path, const ACFEntryData*>> extractedDirs;
+
+    // Directories first, then files in the order they are stored, so reads are
+    // sequential and a prefix file is decoded before the files that need it.
+    std::vector<const std::pair<ACFEntryData, std::string>*> ordered;
+    for (const auto& pair : entries) ordered.push_back(&pair);
+    std::stable_sort(ordered.begin(), ordered.end(), [](const auto* a, const auto* b) {
+        bool fileA = a->first.type == EntryType::File;
+        bool fileB = b->first.type == EntryType::File;
+        if (fileA != fileB) return fileB;
+        return fileA && a->first.dataOffset < b->first.dataOffset;
+    });
+
+    for (const auto* orderedPair : ordered) {
+        const auto& pair = *orderedPair;
         const auto& entry = pair.first;
         const auto& path = pair.second;
-        fs::path fullPath = outputDir / fs::path(path);
+        fs::path fullPath = outputDir / platform::FromInternalPath(path);
+        if (m_DecodePassthrough && entry.method == CompressionMethod::ZstdPassthrough && fullPath.extension() == ".zst") {
+            fullPath.replace_extension();
+        }
 
         if (m_CallbackFunc) {
             m_CallbackFunc(path, 0.0f, entriesProcessed / totalEntries);
@@ -417,30 +1364,70 @@ namespace acf
 
         if (entry.type == EntryType::Directory) {
             fs::create_directories(fullPath);
+            extractedDirs.emplace_back(fullPath, &entry);
         } else if (entry.type == EntryType::File) {
+            if (m_ExtractUpdate != ExtractUpdate::Off) {
+                const bool stored = entry.method == CompressionMethod::ZstdPassthrough && !m_DecodePassthrough;
+                const DiskState state = CompareWithDisk(fullPath, entry, stored ? entry.compressedSize : entry.originalSize,
+                                                        m_ExtractUpdate, stored);
+                if (state != DiskState::Changed) {
+                    if (state == DiskState::MetadataOnly) {
+                        platform::ApplyFileInfo(fullPath, entry.filedatetime, entry.fileattribute, entry.unixMode, m_RestoreSpecialBits);
+                    }
+                    entriesProcessed++;
+                    if (m_CallbackFunc) {
+                        m_CallbackFunc(path, 1.0f, entriesProcessed / totalEntries);
+                    }
+                    continue;
+                }
+            }
             fs::create_directories(fullPath.parent_path());
             
-            std::vector<uint8_t> data = ExtractData(archivePath, path);
-            std::ofstream outputFile(fullPath, std::ios::binary | std::ios::trunc);
-            if (outputFile) {
-                outputFile.write(reinterpret_cast<const char*>(data.data()), data.size());
+            std::vector<uint8_t> data = ExtractEntryData(archiveFile, header, archivePath, entry, path); // CRC is checked inside
+            // An update replaces the file by renaming a complete copy over it, which
+            // also works when an earlier extraction left it read-only and never
+            // writes through a symlink in its place.
+            const bool replace = m_ExtractUpdate != ExtractUpdate::Off;
+            fs::path writePath = fullPath;
+            if (replace) {
+                writePath += ".acfpart";
+                fs::remove(writePath);
             }
+            platform::FileWriter outputFile;
+            const bool opened = outputFile.Open(writePath, data.size());
+            const bool written = opened && outputFile.Write(data.data(), data.size());
+            std::error_code ec;
+            if (!outputFile.Close() || !written) {
+                if (replace && opened) fs::remove(writePath, ec);
+                throw std::runtime_error("Could not write file: " + fullPath.string());
+            }
+            if (replace) {
+                fs::rename(writePath, fullPath, ec);
+                if (ec) {
+                    // Windows refuses to replace a read-only file.
+                    fs::permissions(fullPath, fs::perms::owner_write, fs::perm_options::add | fs::perm_options::nofollow, ec);
+                    fs::rename(writePath, fullPath, ec);
+                }
+                if (ec) {
+                    const std::string reason = ec.message();
+                    fs::remove(writePath, ec);
+                    throw std::runtime_error("Could not replace file: " + fullPath.string() + " (" + reason + ")");
+                }
+            }
+            platform::ApplyFileInfo(fullPath, entry.filedatetime, entry.fileattribute, entry.unixMode, m_RestoreSpecialBits);
         }
 
-        FILETIME ft = DosDateTimeToFileTime(entry.filedatetime);
-        ULARGE_INTEGER uli;
-        uli.LowPart = ft.dwLowDateTime;
-        uli.HighPart = ft.dwHighDateTime;
-        auto ftime = std::filesystem::file_time_type(std::filesystem::file_time_type::duration(uli.QuadPart));
-        std::error_code ec;
-        fs::last_write_time(fullPath, ftime, ec);
-        SetFileAttributesW(fullPath.c_str(), entry.fileattribute);
-
         entriesProcessed++;
         if (m_CallbackFunc) {
             m_CallbackFunc(path, 1.0f, entriesProcessed / totalEntries);
         }
     }
+
+    for (auto it = extractedDirs.rbegin(); it != extractedDirs.rend(); ++it) {
+        const ACFEntryData& entry = *it->second;
+        platform::ApplyFileInfo(it->first, entry.filedatetime, entry.fileattribute, entry.unixMode, m_RestoreSpecialBits);
+    }
+
     if (m_CallbackFunc) {
         m_CallbackFunc("Done.", 1.0f, 1.0f);
     }
@@ -462,15 +1449,16 @@ namespace acf
 
     archiveFile.seekg(header.centralDirOffset);
     
+    const std::string wantedPath = NormalizeInternalPath(archFileName);
+    const size_t recordSize = EntryRecordSize(header);
     ACFEntryData targetEntry;
     bool found = false;
     for (uint64_t i = 0; i < header.entryCount; ++i) {
         ACFEntryData currentEntry;
-        archiveFile.read(reinterpret_cast<char*>(&currentEntry), sizeof(ACFEntryData));
-        std::string path(currentEntry.pathLength, '\0');
-        archiveFile.read(&path[0], currentEntry.pathLength);
+        std::string path;
+        if (!ReadEntry(archiveFile, recordSize, currentEntry, path)) break;
 
-        if (path == archFileName) {
+        if (path == wantedPath) {
             targetEntry = currentEntry;
             found = true;
             break;
@@ -484,14 +1472,119 @@ namespace acf
         throw std::runtime_error("Cannot extract data from a directory entry: " + archFileName);
     }
 
+    return ExtractEntryData(archiveFile, header, archivePath, targetEntry, wantedPath);
+  }
+
+  std::vector<uint8_t> ACFArchiver::ExtractEntryData(std::istream& archiveFile, const ACFHeader& header,
+                                                     const std::string& archivePath, const ACFEntryData& targetEntry,
+                                                     const std::string& archFileName)
+  {
+    if (targetEntry.method == CompressionMethod::ChunkRef) {
+        detail::ChunkRepository& repository = ManifestRepository(archiveFile, header, archivePath);
+        std::vector<detail::ChunkRef> refs(targetEntry.compressedSize / sizeof(detail::ChunkRef));
+        archiveFile.clear();
+        archiveFile.seekg(targetEntry.dataOffset);
+        archiveFile.read(reinterpret_cast<char*>(refs.data()), refs.size() * sizeof(detail::ChunkRef));
+        if (!archiveFile) {
+            throw std::runtime_error("Could not read chunk references for file: " + archFileName);
+        }
+        std::vector<uint8_t> data;
+        data.reserve(targetEntry.originalSize);
+        for (const auto& ref : refs) {
+            auto chunk = repository.Get(ref.hash);
+            data.insert(data.end(), chunk->begin(), chunk->end());
+        }
+        if (crc32(data.data(), data.size()) != targetEntry.crc32) {
+            throw std::runtime_error("CRC32 mismatch for file: " + archFileName);
+        }
+        return data;
+    }
+
+    if (targetEntry.method == CompressionMethod::Uncompressed) {
+        std::vector<uint8_t> data(targetEntry.originalSize);
+        archiveFile.clear();
+        archiveFile.seekg(targetEntry.dataOffset);
+        archiveFile.read(reinterpret_cast<char*>(data.data()), data.size());
+        if (!archiveFile) {
+            throw std::runtime_error("Could not read data of file: " + archFileName);
+        }
+        if (crc32(data.data(), data.size()) != targetEntry.crc32) {
+            throw std::runtime_error("CRC32 mismatch for file: " + archFileName);
+        }
+        return data;
+    }
+
+    // Entries of a similarity group need the decoded content of the group's first file.
+    const std::vector<uint8_t>* prefix = nullptr;
+    if (targetEntry.prefixOffset) {
+        const size_t recordSize = EntryRecordSize(header);
+        archiveFile.clear();
+        archiveFile.seekg(header.centralDirOffset);
+        ACFEntryData prefixEntry{};
+        std::string prefixPath;
+        bool prefixFound = false;
+        for (uint64_t i = 0; i < header.entryCount && !prefixFound; ++i) {
+            if (!ReadEntry(archiveFile, recordSize, prefixEntry, prefixPath)) break;
+            prefixFound = prefixEntry.type == EntryType::File && prefixEntry.dataOffset == targetEntry.prefixOffset &&
+                          !prefixEntry.prefixOffset && prefixEntry.method == CompressionMethod::Zstd;
+        }
+        if (!prefixFound) {
+            throw std::runtime_error("Prefix entry missing for file: " + archFileName);
+        }
+        if (m_PrefixCachePath != archivePath || m_PrefixCacheOffset != prefixEntry.dataOffset ||
+            m_PrefixCacheCrc != prefixEntry.crc32) {
+            m_PrefixCache = ExtractEntryData(archiveFile, header, archivePath, prefixEntry, prefixPath);
+            m_PrefixCachePath = archivePath;
+            m_PrefixCacheOffset = prefixEntry.dataOffset;
+            m_PrefixCacheCrc = prefixEntry.crc32;
+        }
+        prefix = &m_PrefixCache;
+    }
+
+    // Patched entries need the same path from the base archive.
+    std::vector<uint8_t> baseContent;
+    if (targetEntry.method == CompressionMethod::ZstdPatch) {
+        const std::string basePath = ResolveBaseArchive(archiveFile, header, archivePath, m_BaseArchivePath);
+        BaseArchive& base = OpenBase(basePath);
+        auto baseIt = base.files.find(archFileName);
+        if (baseIt == base.files.end()) {
+            throw std::runtime_error("File not found in base archive: " + archFileName);
+        }
+        baseContent = base.reader.ExtractEntryData(base.file, base.header, basePath, baseIt->second, archFileName);
+        prefix = &baseContent;
+    }
+
+    archiveFile.clear();
     archiveFile.seekg(targetEntry.dataOffset);
 
+    // Long-range entries record their window; everything else fits zstd's default limit.
+    int windowLogMax = targetEntry.windowLog ? targetEntry.windowLog : kDefaultWindowLogMax;
+    if (m_DecoderMemoryLimit) {
+        if (targetEntry.windowLog && (1ull << targetEntry.windowLog) > m_DecoderMemoryLimit) {
+            throw std::runtime_error("Decoder window of " + std::to_string((1ull << targetEntry.windowLog) >> 20) +
+                                     " MB exceeds the memory limit for file: " + archFileName);
+        }
+        const int lowest = ZSTD_dParam_getBounds(ZSTD_d_windowLogMax).lowerBound;
+        while (windowLogMax > lowest && (1ull << windowLogMax) > m_DecoderMemoryLimit) --windowLogMax;
+    }
+
     ZSTD_DStream_Ptr dstream(ZSTD_createDStream());
     if (!dstream) { throw std::runtime_error("ZSTD_createDStream() error"); }
     ZSTD_initDStream(dstream.get());
+    ZSTD_DCtx_setParameter(dstream.get(), ZSTD_d_windowLogMax, windowLogMax);
+    if (prefix) {
+        ZSTD_DCtx_refPrefix(dstream.get(), prefix->data(), prefix->size());
+    }
+
+    // Passthrough entries are still decoded to verify the CRC of their content,
+    // but by default the caller gets the stored .zst bytes back.
+    const bool returnStored = targetEntry.method == CompressionMethod::ZstdPassthrough && !m_DecodePassthrough;
+    std::vector<uint8_t> storedData;
+    if (returnStored) storedData.reserve(targetEntry.compressedSize);
 
     std::vector<uint8_t> decompressedData;
     decompressedData.reserve(targetEntry.originalSize);
+    uint32_t crc = 0;
     
     size_t const inBuffSize = ZSTD_DStreamInSize();
     std::vector<char> inBuff(inBuffSize);
@@ -503,6 +1596,9 @@ namespace acf
         size_t toRead = std::min(static_cast<uint64_t>(inBuff.size()), targetEntry.compressedSize - totalRead);
         archiveFile.read(inBuff.data(), toRead);
         totalRead += toRead;
+        if (returnStored) {
+            storedData.insert(storedData.end(), inBuff.data(), inBuff.data() + toRead);
+        }
 
         ZSTD_inBuffer inBuffer = { inBuff.data(), toRead, 0 };
         while (inBuffer.pos < inBuffer.size) {
@@ -511,15 +1607,28 @@ namespace acf
             if (ZSTD_isError(ret)) {
                 throw std::runtime_error("ZSTD_decompressStream error");
             }
-            decompressedData.insert(decompressedData.end(), reinterpret_cast<uint8_t*>(outBuffer.dst), reinterpret_cast<uint8_t*>(outBuffer.dst) + outBuffer.pos);
+            if (returnStored) {
+                crc = crc32_update(crc, outBuffer.dst, outBuffer.pos);
+            } else {
+                decompressedData.insert(decompressedData.end(), reinterpret_cast<uint8_t*>(outBuffer.dst), reinterpret_cast<uint8_t*>(outBuffer.dst) + outBuffer.pos);
+            }
         }
     }
 
-    if (crc32(decompressedData.data(), decompressedData.size()) != targetEntry.crc32) {
+    if (!returnStored) {
+        if (auto filter = detail::CreateFilter(targetEntry.filter, targetEntry.filterParam, false)) {
+            std::vector<uint8_t> unfiltered;
+            unfiltered.reserve(decompressedData.size());
+            filter->Process(decompressedData.data(), decompressedData.size(), true, unfiltered);
+            decompressedData.swap(unfiltered);
+        }
+        crc = crc32(decompressedData.data(), decompressedData.size());
+    }
+    if (crc != targetEntry.crc32) {
         throw std::runtime_error("CRC32 mismatch for file: " + archFileName);
     }
 
-    return decompressedData;
+    return returnStored ? storedData : decompressedData;
   }
                                   
   std::vector<std::pair<ACFEntryData, std::string>> ACFArchiver::List(const std::string& archivePath)
@@ -535,11 +1644,15 @@ namespace acf
       throw std::runtime_error("Not a valid ACF archive: " + archivePath);
     }
 
-    archiveFile.seekg(header.centralDirOffset);
-    
-    size_t cdSize = 0;
-    if (archiveFile.seekg(0, std::ios::end)) {
-        cdSize = static_cast<size_t>(archiveFile.tellg()) - header.centralDirOffset;
+    archiveFile.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(archiveFile.tellg());
+    uint64_t cdSize = fileSize - std::min(header.centralDirOffset, fileSize);
+    if ((header.flags & ACF_FLAG_FRONT_INDEX) && header.centralDirOffset >= sizeof(ACFHeader) + sizeof(uint64_t)) {
+        archiveFile.seekg(header.centralDirOffset - sizeof(uint64_t));
+        archiveFile.read(reinterpret_cast<char*>(&cdSize), sizeof(cdSize));
+    }
+    if (!archiveFile || header.centralDirOffset > fileSize || cdSize > fileSize - header.centralDirOffset) {
+        throw std::runtime_error("Central directory offset out of range. Archive is likely corrupted.");
     }
     archiveFile.seekg(header.centralDirOffset);
 
@@ -549,27 +1662,7 @@ namespace acf
         throw std::runtime_error("Central directory CRC32 mismatch. Archive is likely corrupted.");
     }
 
-    std::vector<std::pair<ACFEntryData, std::string>> fileList;
-    fileList.reserve(header.entryCount);
-
-    const char* buffer_ptr = centralDirBuffer.data();
-    const char* buffer_end = centralDirBuffer.data() + cdSize;
-
-    for (uint64_t i = 0; i < header.entryCount; ++i)
-    {
-      if (buffer_ptr + sizeof(ACFEntryData) > buffer_end) break;
-      ACFEntryData entryData;
-      memcpy(&entryData, buffer_ptr, sizeof(ACFEntryData));
-      buffer_ptr += sizeof(ACFEntryData);
-      
-      if (buffer_ptr + entryData.pathLength > buffer_end) break;
-      std::string path(buffer_ptr, entryData.pathLength);
-      buffer_ptr += entryData.pathLength;
-      
-      fileList.emplace_back(entryData, path);
-    }
-
-    return fileList;
+    return detail::ParseCentralDirectory(centralDirBuffer.data(), cdSize, header);
   }
 
 } // namespace acf
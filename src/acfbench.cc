@@ -0,0 +1,471 @@
+#include "acf.hh"
+#include "acfplatform.hh"
+#include "acfinternal.hh"
+#include "acffilter.hh"
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <random>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t kSampleChunk = 1 << 20;      // Large files are sampled in chunks of this size...
+constexpr uint64_t kMaxSamplePerFile = 4 << 20; // ...up to this much per file.
+
+struct Stratum
+{
+    std::vector<std::filesystem::path> files;
+    std::vector<uint64_t> sizes;
+    uint64_t totalBytes = 0;
+};
+
+std::string StratumKey(const std::filesystem::path& p, uint64_t size) {
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    int sizeClass = 0; // Powers of four: <4 B, <16 B, ... <1 GiB, ...
+    while (size >= 4) { size >>= 2; ++sizeClass; }
+    return ext + '|' + std::to_string(sizeClass);
+}
+
+// Reads `take` bytes of the file as evenly spaced chunks, so that headers,
+// bodies and tails of large files are all represented.
+std::vector<uint8_t> ReadSpread(const std::filesystem::path& p, uint64_t size, uint64_t take) {
+    std::vector<uint8_t> data;
+    std::ifstream in(p, std::ios::binary);
+    if (!in) return data;
+
+    uint64_t chunks = std::max<uint64_t>(1, (take + kSampleChunk - 1) / kSampleChunk);
+    uint64_t chunkSize = take / chunks;
+    data.resize(chunks * chunkSize);
+    size_t filled = 0;
+    for (uint64_t i = 0; i < chunks; ++i) {
+        uint64_t offset = (chunks == 1) ? 0 : i * ((size - chunkSize) / (chunks - 1));
+        in.seekg(offset);
+        in.read(reinterpret_cast<char*>(data.data() + filled), chunkSize);
+        filled += static_cast<size_t>(in.gcount());
+        if (!in) in.clear();
+    }
+    data.resize(filled);
+    return data;
+}
+
+struct ZSTD_CCtx_Deleter { void operator()(ZSTD_CCtx* ptr) const { ZSTD_freeCCtx(ptr); } };
+struct ZSTD_DCtx_Deleter { void operator()(ZSTD_DCtx* ptr) const { ZSTD_freeDCtx(ptr); } };
+
+// Repeats compression and decompression of the sample set until enough time
+// has passed for a stable speed figure.
+acf::LevelBenchResult BenchOne(const std::vector<acf::detail::InputSample>& samples, int level, int strategy) {
+    using clock = std::chrono::steady_clock;
+    constexpr double kMinSeconds = 0.1;
+
+    std::unique_ptr<ZSTD_CCtx, ZSTD_CCtx_Deleter> cctx(ZSTD_createCCtx());
+    std::unique_ptr<ZSTD_DCtx, ZSTD_DCtx_Deleter> dctx(ZSTD_createDCtx());
+    if (!cctx || !dctx) throw std::runtime_error("ZSTD context allocation failed");
+    ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_strategy, strategy);
+
+    std::vector<std::vector<uint8_t>> compressed(samples.size());
+    uint64_t sampleBytes = 0;
+    double weightedOriginal = 0, weightedCompressed = 0;
+
+    int rounds = 0;
+    auto start = clock::now();
+    double compressSeconds = 0;
+    do {
+        for (size_t i = 0; i < samples.size(); ++i) {
+            const auto& src = samples[i].data;
+            auto& dst = compressed[i];
+            dst.resize(ZSTD_compressBound(src.size()));
+            size_t const csize = ZSTD_compress2(cctx.get(), dst.data(), dst.size(), src.data(), src.size());
+            if (ZSTD_isError(csize)) throw std::runtime_error("ZSTD_compress2 error");
+            dst.resize(csize);
+            if (rounds == 0) {
+                sampleBytes += src.size();
+                weightedOriginal += samples[i].weight * src.size();
+                weightedCompressed += samples[i].weight * csize;
+            }
+        }
+        ++rounds;
+        compressSeconds = std::chrono::duration<double>(clock::now() - start).count();
+    } while (compressSeconds < kMinSeconds);
+    int compressRounds = rounds;
+
+    std::vector<uint8_t> out;
+    rounds = 0;
+    start = clock::now();
+    double decompressSeconds = 0;
+    do {
+        for (size_t i = 0; i < samples.size(); ++i) {
+            out.resize(samples[i].data.size());
+            size_t const dsize = ZSTD_decompressDCtx(dctx.get(), out.data(), out.size(), compressed[i].data(), compressed[i].size());
+            if (ZSTD_isError(dsize)) throw std::runtime_error("ZSTD_decompressDCtx error");
+        }
+        ++rounds;
+        decompressSeconds = std::chrono::duration<double>(clock::now() - start).count();
+    } while (decompressSeconds < kMinSeconds);
+
+    acf::LevelBenchResult result;
+    result.level = level;
+    result.strategy = strategy;
+    result.ratio = weightedCompressed > 0 ? weightedOriginal / weightedCompressed : 1.0;
+    result.compressMBps = (sampleBytes * compressRounds / 1e6) / compressSeconds;
+    result.decompressMBps = (sampleBytes * rounds / 1e6) / decompressSeconds;
+    return result;
+}
+
+// --- Estimation ---
+constexpr uint64_t kEstimateBlock = 1 << 20;
+constexpr double kMinEstimateBlocks = 64;
+
+// How Create() would store a file, decided from its path and first bytes.
+struct StoragePlan
+{
+    bool stored = false; // Uncompressed (storeAligned) or a .zst input kept as-is
+    acf::FilterType filter = acf::FilterType::None;
+    uint8_t filterParam = 0;
+};
+
+struct Interval
+{
+    double value = 0, low = 0, high = 0;
+};
+
+// Ratio estimator of the population total of y, given the population total X
+// of x and a sample drawn with probability f. The bounds are +/-1.96 standard errors.
+Interval RatioEstimate(const std::vector<double>& x, const std::vector<double>& y, double X, double f) {
+    Interval r;
+    size_t n = x.size();
+    double sx = 0, sy = 0;
+    for (size_t i = 0; i < n; ++i) { sx += x[i]; sy += y[i]; }
+    if (n == 0 || sx <= 0) return r;
+
+    double R = sy / sx;
+    r.value = r.low = r.high = R * X;
+    if (n < 2 || f >= 1.0) return r;
+
+    double ss = 0;
+    for (size_t i = 0; i < n; ++i) {
+        double e = y[i] - R * x[i];
+        ss += e * e;
+    }
+    double meanX = sx / n;
+    double variance = X * X * (1.0 - f) / (n * meanX * meanX) * ss / (n - 1);
+    double margin = 1.96 * std::sqrt(variance);
+    r.low = std::max(0.0, r.value - margin);
+    r.high = r.value + margin;
+    return r;
+}
+
+} // namespace
+
+namespace acf::detail
+{
+  std::vector<InputSample> SampleInputs(const std::vector<std::filesystem::path>& files,
+                                        uint64_t sampleBytes)
+  {
+    std::map<std::string, Stratum> strata;
+    uint64_t totalBytes = 0;
+    for (const auto& file : files) {
+        platform::FileInfo info;
+        if (!platform::Stat(file, info) || info.size == 0) continue;
+        Stratum& stratum = strata[StratumKey(file, info.size)];
+        stratum.files.push_back(file);
+        stratum.sizes.push_back(info.size);
+        stratum.totalBytes += info.size;
+        totalBytes += info.size;
+    }
+
+    std::vector<InputSample> samples;
+    if (totalBytes == 0) return samples;
+
+    for (const auto& [key, stratum] : strata) {
+        // Every stratum gets at least one chunk, however small its share.
+        uint64_t budget = static_cast<uint64_t>(static_cast<double>(sampleBytes) * stratum.totalBytes / totalBytes);
+        budget = std::min(stratum.totalBytes, std::max(budget, kSampleChunk));
+
+        // Visit files at evenly spaced indices first so the sample spans the
+        // whole stratum, then the rest if budget is left.
+        const size_t n = stratum.files.size();
+        uint64_t averageTake = std::max<uint64_t>(1, std::min(kMaxSamplePerFile, stratum.totalBytes / n));
+        size_t wanted = static_cast<size_t>(std::clamp<uint64_t>((budget + averageTake - 1) / averageTake, 1, n));
+        std::vector<size_t> order;
+        std::vector<bool> queued(n, false);
+        for (size_t j = 0; j < wanted; ++j) {
+            order.push_back(j * n / wanted);
+            queued[j * n / wanted] = true;
+        }
+        for (size_t idx = 0; idx < n; ++idx) {
+            if (!queued[idx]) order.push_back(idx);
+        }
+
+        std::vector<InputSample> stratumSamples;
+        uint64_t sampled = 0;
+        for (size_t idx : order) {
+            if (sampled >= budget) break;
+            uint64_t take = std::min({ stratum.sizes[idx], kMaxSamplePerFile, budget - sampled });
+            InputSample sample;
+            sample.data = ReadSpread(stratum.files[idx], stratum.sizes[idx], take);
+            if (sample.data.empty()) continue;
+            sampled += sample.data.size();
+            stratumSamples.push_back(std::move(sample));
+        }
+        if (sampled == 0) continue;
+
+        double weight = static_cast<double>(stratum.totalBytes) / sampled;
+        for (auto& sample : stratumSamples) {
+            sample.weight = weight;
+            samples.push_back(std::move(sample));
+        }
+    }
+    return samples;
+  }
+
+} // namespace acf::detail
+
+namespace acf
+{
+  std::vector<LevelBenchResult> BenchLevels(const std::vector<std::string>& inputPaths,
+                                            const LevelBenchOptions& options)
+  {
+    std::vector<std::filesystem::path> files, dirs;
+    detail::CollectInputs(inputPaths, files, dirs);
+    std::vector<detail::InputSample> samples = detail::SampleInputs(files, options.sampleBytes);
+    if (samples.empty()) {
+        throw std::runtime_error("No input data to benchmark.");
+    }
+
+    std::vector<std::pair<int, int>> configs;
+    for (int strategy : options.strategies) {
+        for (int level : options.levels) {
+            configs.emplace_back(level, strategy);
+        }
+    }
+
+    std::vector<LevelBenchResult> results(configs.size());
+    std::atomic<size_t> next{0};
+    std::exception_ptr failure;
+    std::atomic<bool> failed{false};
+
+    unsigned threadCount = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min<unsigned>(threadCount, static_cast<unsigned>(configs.size()));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < configs.size() && !failed; i = next++) {
+                try {
+                    results[i] = BenchOne(samples, configs[i].first, configs[i].second);
+                } catch (...) {
+                    if (!failed.exchange(true)) failure = std::current_exception();
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    if (failure) std::rethrow_exception(failure);
+
+    for (auto& r : results) {
+        r.pareto = std::none_of(results.begin(), results.end(), [&](const LevelBenchResult& o) {
+            bool notWorse = o.ratio >= r.ratio && o.compressMBps >= r.compressMBps && o.decompressMBps >= r.decompressMBps;
+            bool better = o.ratio > r.ratio || o.compressMBps > r.compressMBps || o.decompressMBps > r.decompressMBps;
+            return notWorse && better;
+        });
+    }
+    std::sort(results.begin(), results.end(), [](const LevelBenchResult& a, const LevelBenchResult& b) {
+        return a.ratio > b.ratio;
+    });
+    return results;
+  }
+
+  ArchiveEstimate ACFArchiver::Estimate(const std::vector<std::string>& inputPaths,
+                                        const std::string& basePath,
+                                        const std::string& internalBasePath,
+                                        double sampleFraction)
+  {
+    namespace fs = std::filesystem;
+    using clock = std::chrono::steady_clock;
+
+    // Each of these stores files against earlier data the sample does not see.
+    if (m_Profile.longRange || !m_BaseArchivePath.empty() || !m_RepositoryPath.empty() ||
+        m_Profile.order != FileOrder::Path || !m_Profile.layoutProfile.empty()) {
+        throw std::runtime_error("Estimate cannot model long-range mode, a base archive, a chunk repository, "
+                                 "a file order or a layout profile.");
+    }
+
+    std::vector<fs::path> files, dirs;
+    detail::CollectInputs(inputPaths, files, dirs, m_Profile);
+
+    ArchiveEstimate estimate;
+    estimate.fileCount = files.size();
+    estimate.dirCount = dirs.size();
+
+    // Header and central directory are known exactly.
+    fs::path fsBasePath(basePath);
+    double fixedBytes = sizeof(ACFHeader);
+    for (const auto& dir : dirs) {
+        fixedBytes += sizeof(ACFEntryData) + detail::InternalPathFor(dir, fsBasePath, internalBasePath, true).size();
+    }
+    std::vector<uint64_t> sizes(files.size());
+    uint64_t totalBlocks = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        platform::FileInfo info;
+        platform::Stat(files[i], info);
+        sizes[i] = info.size;
+        estimate.inputBytes += info.size;
+        totalBlocks += (info.size + kEstimateBlock - 1) / kEstimateBlock;
+        fixedBytes += sizeof(ACFEntryData) + detail::InternalPathFor(files[i], fsBasePath, internalBasePath, false).size();
+    }
+
+    // Bernoulli sample of blocks with a fixed seed, so repeated runs agree.
+    double f = std::clamp(sampleFraction, 0.0, 1.0);
+    if (totalBlocks > 0) f = std::max(f, std::min(1.0, kMinEstimateBlocks / totalBlocks));
+    struct Block { size_t file; uint64_t offset; uint64_t size; };
+    std::vector<Block> blocks;
+    std::mt19937_64 rng(0xACF);
+    std::bernoulli_distribution pick(f);
+    for (size_t i = 0; i < files.size(); ++i) {
+        for (uint64_t offset = 0; offset < sizes[i]; offset += kEstimateBlock) {
+            if (pick(rng)) blocks.push_back({ i, offset, std::min(kEstimateBlock, sizes[i] - offset) });
+        }
+    }
+
+    // Storage decisions of Create() for every file with a sampled block:
+    // aligned storage by path, then passthrough and the pre-filter from the
+    // first chunk it reads.
+    std::vector<StoragePlan> plans(files.size());
+    {
+        std::vector<size_t> sampledFiles;
+        for (const auto& block : blocks) {
+            if (sampledFiles.empty() || sampledFiles.back() != block.file) sampledFiles.push_back(block.file);
+        }
+        std::atomic<size_t> nextFile{0};
+        unsigned planThreads = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(), static_cast<unsigned>(sampledFiles.size())));
+        std::vector<std::thread> planners;
+        for (unsigned t = 0; t < planThreads && !sampledFiles.empty(); ++t) {
+            planners.emplace_back([&]() {
+                std::vector<uint8_t> head(ZSTD_CStreamInSize());
+                for (size_t k = nextFile++; k < sampledFiles.size(); k = nextFile++) {
+                    const size_t i = sampledFiles[k];
+                    StoragePlan& plan = plans[i];
+                    const std::string internalPath = detail::InternalPathFor(files[i], fsBasePath, internalBasePath, false);
+                    if (std::any_of(m_Profile.storeAligned.begin(), m_Profile.storeAligned.end(),
+                                    [&](const std::string& pattern) { return detail::GlobMatch(pattern, internalPath); })) {
+                        plan.stored = true;
+                        continue;
+                    }
+                    std::ifstream input(files[i], std::ios::binary);
+                    input.read(reinterpret_cast<char*>(head.data()), head.size());
+                    const size_t got = static_cast<size_t>(input.gcount());
+                    uint32_t magic = 0;
+                    if (got >= sizeof(magic)) memcpy(&magic, head.data(), sizeof(magic));
+                    if (m_Profile.zstdPassthrough && magic == ZSTD_MAGICNUMBER) {
+                        plan.stored = true;
+                    } else if (m_Profile.filters && got > 0) {
+                        plan.filter = detail::SniffFilter(head.data(), got, plan.filterParam);
+                    }
+                }
+            });
+        }
+        for (auto& planner : planners) planner.join();
+    }
+
+    std::vector<double> blockBytes(blocks.size()), compressedBytes(blocks.size());
+    std::vector<double> cpuSeconds(blocks.size()), wallSeconds(blocks.size());
+    std::atomic<size_t> next{0};
+    // Create() checksums every input byte; the CRCs end up here so that the
+    // work is really done and timed, not optimised away.
+    std::atomic<uint32_t> crcSink{0};
+    unsigned threadCount = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(), static_cast<unsigned>(blocks.size())));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threadCount && !blocks.empty(); ++t) {
+        workers.emplace_back([&]() {
+            std::unique_ptr<ZSTD_CCtx, ZSTD_CCtx_Deleter> cctx(ZSTD_createCCtx());
+            ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, m_Profile.level);
+            ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_strategy, m_Profile.strategy);
+            std::vector<char> in(kEstimateBlock), out(ZSTD_compressBound(kEstimateBlock));
+            std::vector<uint8_t> filtered;
+
+            for (size_t i = next++; i < blocks.size(); i = next++) {
+                const Block& block = blocks[i];
+                const StoragePlan& plan = plans[block.file];
+                auto start = clock::now();
+                std::ifstream input(files[block.file], std::ios::binary);
+                input.seekg(block.offset);
+                input.read(in.data(), block.size);
+                size_t got = static_cast<size_t>(input.gcount());
+                auto readDone = clock::now();
+
+                crcSink.fetch_xor(detail::Crc32Update(0, in.data(), got), std::memory_order_relaxed);
+                size_t csize = got;
+                if (!plan.stored) {
+                    const void* data = in.data();
+                    if (auto filter = detail::CreateFilter(plan.filter, plan.filterParam, true)) {
+                        filtered.clear();
+                        filter->Process(reinterpret_cast<const uint8_t*>(in.data()), got, true, filtered);
+                        data = filtered.data();
+                    }
+                    csize = ZSTD_compress2(cctx.get(), out.data(), out.size(), data, got);
+                    if (ZSTD_isError(csize)) csize = got;
+                }
+                auto done = clock::now();
+
+                blockBytes[i] = static_cast<double>(got);
+                compressedBytes[i] = static_cast<double>(csize);
+                cpuSeconds[i] = std::chrono::duration<double>(done - readDone).count();
+                wallSeconds[i] = std::chrono::duration<double>(done - start).count();
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    for (double b : blockBytes) estimate.sampledBytes += static_cast<uint64_t>(b);
+    estimate.sampledBlocks = blocks.size();
+
+    double X = static_cast<double>(estimate.inputBytes);
+    Interval size = RatioEstimate(blockBytes, compressedBytes, X, f);
+    Interval cpu = RatioEstimate(blockBytes, cpuSeconds, X, f);
+    Interval wall = RatioEstimate(blockBytes, wallSeconds, X, f);
+
+    estimate.archiveBytes = size.value + fixedBytes;
+    estimate.archiveBytesLow = size.low + fixedBytes;
+    estimate.archiveBytesHigh = size.high + fixedBytes;
+    estimate.cpuSeconds = cpu.value;
+    estimate.cpuSecondsLow = cpu.low;
+    estimate.cpuSecondsHigh = cpu.high;
+    estimate.wallSeconds = wall.value;
+    estimate.wallSecondsLow = wall.low;
+    estimate.wallSecondsHigh = wall.high;
+    return estimate;
+  }
+
+  CompressionProfile RecommendProfile(const std::vector<LevelBenchResult>& results,
+                                      double minCompressMBps)
+  {
+    const LevelBenchResult* best = nullptr;
+    const LevelBenchResult* fastest = nullptr;
+    for (const auto& r : results) {
+        if (!fastest || r.compressMBps > fastest->compressMBps) fastest = &r;
+        if (!r.pareto || r.compressMBps < minCompressMBps) continue;
+        if (!best || r.ratio > best->ratio) best = &r;
+    }
+    if (!best) best = fastest;
+
+    CompressionProfile profile;
+    if (best) {
+        profile.level = best->level;
+        profile.strategy = best->strategy;
+    }
+    return profile;
+  }
+
+} // namespace acf
@@ -0,0 +1,125 @@
+#include "acf.hh"
+#include <vector>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+
+namespace {
+
+struct BlockKey
+{
+    uint64_t archive;
+    uint64_t entry;
+    uint64_t block;
+
+    bool operator==(const BlockKey& other) const {
+        return archive == other.archive && entry == other.entry && block == other.block;
+    }
+};
+
+uint64_t Mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+struct BlockKeyHasher
+{
+    size_t operator()(const BlockKey& key) const {
+        return static_cast<size_t>(Mix(key.archive * 0x9E3779B97F4A7C15ull ^ Mix(key.entry ^ Mix(key.block))));
+    }
+};
+
+} // namespace
+
+namespace acf
+{
+  struct BlockCache::Shard
+  {
+    using Entry = std::pair<BlockKey, Block>;
+
+    std::mutex mutex;
+    std::list<Entry> lru;
+    std::unordered_map<BlockKey, std::list<Entry>::iterator, BlockKeyHasher> map;
+    uint64_t bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+  };
+
+  BlockCache::BlockCache(size_t capacityBytes, size_t shardCount)
+  {
+    shardCount = std::max<size_t>(shardCount, 1);
+    m_ShardCapacity = capacityBytes / shardCount;
+    for (size_t i = 0; i < shardCount; ++i) {
+        m_Shards.push_back(std::make_unique<Shard>());
+    }
+  }
+
+  BlockCache::~BlockCache() {}
+
+  BlockCache::Shard& BlockCache::ShardFor(uint64_t archive, uint64_t entry, uint64_t block) const
+  {
+    return *m_Shards[BlockKeyHasher()({archive, entry, block}) % m_Shards.size()];
+  }
+
+  BlockCache::Block BlockCache::Find(uint64_t archive, uint64_t entry, uint64_t block)
+  {
+    Shard& shard = ShardFor(archive, entry, block);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find({archive, entry, block});
+    if (it == shard.map.end()) {
+        ++shard.misses;
+        return nullptr;
+    }
+    ++shard.hits;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->second;
+  }
+
+  void BlockCache::Insert(uint64_t archive, uint64_t entry, uint64_t block, Block data)
+  {
+    Shard& shard = ShardFor(archive, entry, block);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const BlockKey key{archive, entry, block};
+    if (shard.map.count(key)) return;
+    shard.bytes += data->size();
+    shard.lru.emplace_front(key, std::move(data));
+    shard.map[key] = shard.lru.begin();
+    while (shard.bytes > m_ShardCapacity && shard.lru.size() > 1) {
+        shard.bytes -= shard.lru.back().second->size();
+        shard.map.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+        ++shard.evictions;
+    }
+  }
+
+  BlockCacheStats BlockCache::Stats() const
+  {
+    BlockCacheStats stats;
+    for (const auto& shard : m_Shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.hits += shard->hits;
+        stats.misses += shard->misses;
+        stats.evictions += shard->evictions;
+        stats.blocks += shard->lru.size();
+        stats.bytes += shard->bytes;
+    }
+    return stats;
+  }
+
+  void BlockCache::Clear()
+  {
+    for (const auto& shard : m_Shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->lru.clear();
+        shard->map.clear();
+        shard->bytes = 0;
+    }
+  }
+
+} // namespace acf
@@ -1,17 +1,23 @@
 #include "acf.hh"
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <string>
 #include <iomanip>
 #include <sstream>
-#include <windows.h>
+#include <map>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+#include <memory>
 
 namespace {
 
 std::string DosDateTimeToString(uint32_t dosDateTime) {
     if (dosDateTime == 0) return "1980-01-01 00:00:00";
-    WORD dosDate = static_cast<WORD>(dosDateTime >> 16);
-    WORD dosTime = static_cast<WORD>(dosDateTime & 0xFFFF);
+    uint16_t dosDate = static_cast<uint16_t>(dosDateTime >> 16);
+    uint16_t dosTime = static_cast<uint16_t>(dosDateTime & 0xFFFF);
 
     int year = ((dosDate >> 9) & 0x7F) + 1980;
     int month = (dosDate >> 5) & 0x0F;
@@ -33,14 +39,205 @@ std::string DosDateTimeToString(uint32_t dosDateTime) {
 
 std::string AttrToString(uint8_t attr) {
     std::string s;
-    s += (attr & FILE_ATTRIBUTE_READONLY) ? 'R' : '-';
-    s += (attr & FILE_ATTRIBUTE_HIDDEN)   ? 'H' : '-';
-    s += (attr & FILE_ATTRIBUTE_SYSTEM)   ? 'S' : '-';
-    s += (attr & FILE_ATTRIBUTE_DIRECTORY) ? 'D' : '-';
-    s += (attr & FILE_ATTRIBUTE_ARCHIVE)  ? 'A' : '-';
+    s += (attr & acf::ATTR_READONLY)  ? 'R' : '-';
+    s += (attr & acf::ATTR_HIDDEN)    ? 'H' : '-';
+    s += (attr & acf::ATTR_SYSTEM)    ? 'S' : '-';
+    s += (attr & acf::ATTR_DIRECTORY) ? 'D' : '-';
+    s += (attr & acf::ATTR_ARCHIVE)   ? 'A' : '-';
     return s;
 }
 
+// Options that also accept their value as the next argument ("--base prev.acf").
+const char* const kValueOptions[] = { "base", "repo", "layout-profile" };
+
+// Positional arguments plus "--name" / "--name=value" options.
+struct CommandLine {
+    std::vector<std::string> args;
+    std::map<std::string, std::string> options;
+
+    bool Has(const std::string& name) const { return options.count(name) != 0; }
+    std::string Get(const std::string& name, const std::string& def = "") const {
+        auto it = options.find(name);
+        return it != options.end() ? it->second : def;
+    }
+};
+
+CommandLine ParseCommandLine(int argc, char** argv, int first) {
+    CommandLine cl;
+    for (int i = first; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                std::string name = arg.substr(2);
+                bool takesValue = std::find(std::begin(kValueOptions), std::end(kValueOptions), name) != std::end(kValueOptions);
+                cl.options[name] = (takesValue && i + 1 < argc) ? argv[++i] : "";
+            } else {
+                cl.options[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            }
+        } else {
+            cl.args.push_back(arg);
+        }
+    }
+    return cl;
+}
+
+// Accepts plain seconds or a number with an s/m/h suffix ("90m", "2h").
+double ParseDuration(const std::string& s) {
+    size_t used = 0;
+    double value = std::stod(s, &used);
+    std::string unit = s.substr(used);
+    if (unit == "m") return value * 60.0;
+    if (unit == "h") return value * 3600.0;
+    if (unit.empty() || unit == "s") return value;
+    throw std::runtime_error("Invalid duration: " + s);
+}
+
+const char* const kStrategyNames[] = {
+    "default", "fast", "dfast", "greedy", "lazy", "lazy2", "btlazy2", "btopt", "btultra", "btultra2"
+};
+
+std::string StrategyName(int strategy) {
+    if (strategy >= 0 && strategy < static_cast<int>(std::size(kStrategyNames))) return kStrategyNames[strategy];
+    return std::to_string(strategy);
+}
+
+int ParseStrategy(const std::string& name) {
+    for (int i = 0; i < static_cast<int>(std::size(kStrategyNames)); ++i) {
+        if (name == kStrategyNames[i]) return i;
+    }
+    throw std::runtime_error("Unknown strategy: " + name);
+}
+
+std::vector<std::string> SplitList(const std::string& s) {
+    std::vector<std::string> items;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// "1-19", "1,3,9" or a mix of both.
+std::vector<int> ParseLevels(const std::string& s) {
+    std::vector<int> levels;
+    for (const auto& item : SplitList(s)) {
+        size_t dash = item.find('-', 1);
+        if (dash == std::string::npos) {
+            levels.push_back(std::stoi(item));
+        } else {
+            for (int l = std::stoi(item.substr(0, dash)); l <= std::stoi(item.substr(dash + 1)); ++l) {
+                levels.push_back(l);
+            }
+        }
+    }
+    return levels;
+}
+
+// Plain bytes or a number with a k/m suffix ("4k", "2m").
+uint64_t ParseByteSize(const std::string& s) {
+    size_t used = 0;
+    uint64_t value = std::stoull(s, &used);
+    std::string unit = s.substr(used);
+    if (unit == "k" || unit == "K") return value << 10;
+    if (unit == "m" || unit == "M") return value << 20;
+    if (unit.empty()) return value;
+    throw std::runtime_error("Invalid size: " + s);
+}
+
+acf::CompressionProfile ProfileFromOptions(const CommandLine& cl) {
+    acf::CompressionProfile profile;
+    if (cl.Has("level")) profile.level = std::stoi(cl.Get("level"));
+    if (cl.Has("strategy")) profile.strategy = ParseStrategy(cl.Get("strategy"));
+    if (cl.Has("no-passthrough")) profile.zstdPassthrough = false;
+    if (cl.Has("no-filters")) profile.filters = false;
+    if (cl.Has("order")) {
+        const std::string order = cl.Get("order");
+        if (order == "path") profile.order = acf::FileOrder::Path;
+        else if (order == "similar") profile.order = acf::FileOrder::Similarity;
+        else if (order == "minhash") profile.order = acf::FileOrder::MinHash;
+        else throw std::runtime_error("Unknown file order: " + order);
+    }
+    if (cl.Has("read-order")) {
+        const std::string readOrder = cl.Get("read-order");
+        if (readOrder == "path") profile.readOrder = acf::ReadOrder::Path;
+        else if (readOrder == "inode") profile.readOrder = acf::ReadOrder::Inode;
+        else if (readOrder == "extent") profile.readOrder = acf::ReadOrder::Extent;
+        else throw std::runtime_error("Unknown read order: " + readOrder);
+    }
+    if (cl.Has("read-ahead")) profile.readAheadBytes = ParseByteSize(cl.Get("read-ahead"));
+    if (cl.Has("front-index")) profile.frontIndex = true;
+    if (cl.Has("include")) profile.include = SplitList(cl.Get("include"));
+    if (cl.Has("exclude")) profile.exclude = SplitList(cl.Get("exclude"));
+    if (cl.Has("ignore-file")) profile.ignoreFileName = cl.Get("ignore-file").empty() ? ".acfignore" : cl.Get("ignore-file");
+    if (cl.Has("layout-profile")) profile.layoutProfile = acf::LoadAccessProfile(cl.Get("layout-profile"));
+    if (cl.Has("store-aligned")) profile.storeAligned = SplitList(cl.Get("store-aligned"));
+    if (cl.Has("align")) profile.alignment = static_cast<uint32_t>(ParseByteSize(cl.Get("align")));
+    if (cl.Has("long")) {
+        profile.longRange = true;
+        if (!cl.Get("long").empty()) profile.maxWindowLog = std::stoi(cl.Get("long"));
+        if (cl.Has("long-min-mb")) profile.longRangeMinSize = std::stoull(cl.Get("long-min-mb")) << 20;
+    }
+    if (cl.Has("adapt") || cl.Has("target-mbps") || cl.Has("deadline")) {
+        profile.adaptive = true;
+        if (cl.Has("min-level")) profile.minLevel = std::stoi(cl.Get("min-level"));
+        if (cl.Has("max-level")) profile.maxLevel = std::stoi(cl.Get("max-level"));
+        if (cl.Has("target-mbps")) profile.targetMBps = std::stod(cl.Get("target-mbps"));
+        if (cl.Has("deadline")) profile.deadlineSeconds = ParseDuration(cl.Get("deadline"));
+        if (profile.targetMBps <= 0 && profile.deadlineSeconds <= 0) {
+            throw std::runtime_error("--adapt needs --target-mbps=N or --deadline=T");
+        }
+    }
+    return profile;
+}
+
+std::string FormatBytes(double bytes) {
+    const char* units[] = { "B", "KB", "MB", "GB", "TB", "PB" };
+    int unit = 0;
+    while (bytes >= 1024.0 && unit < 5) { bytes /= 1024.0; ++unit; }
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(unit ? 2 : 0) << bytes << " " << units[unit];
+    return oss.str();
+}
+
+std::string FormatSeconds(double seconds) {
+    std::ostringstream oss;
+    long total = static_cast<long>(seconds + 0.5);
+    oss << std::setfill('0') << total / 3600 << ":" << std::setw(2) << (total / 60) % 60 << ":" << std::setw(2) << total % 60;
+    return oss.str();
+}
+
+// Bytes x and cat deliver for the entry: stored .zst inputs come out as stored.
+uint64_t DeliveredSize(const acf::ACFEntryData& entry) {
+    return entry.method == acf::CompressionMethod::ZstdPassthrough ? entry.compressedSize : entry.originalSize;
+}
+
+void PrintEstimate(const acf::ArchiveEstimate& e, const std::string& archivePath, double deadlineSeconds) {
+    std::cout << "Inputs        : " << e.fileCount << " files, " << e.dirCount << " directories, "
+              << FormatBytes(e.inputBytes) << std::endl;
+    std::cout << "Sampled       : " << e.sampledBlocks << " blocks, " << FormatBytes(e.sampledBytes) << std::endl;
+    std::cout << "Archive size  : " << FormatBytes(e.archiveBytes)
+              << "  (95%: " << FormatBytes(e.archiveBytesLow) << " - " << FormatBytes(e.archiveBytesHigh) << ")" << std::endl;
+    std::cout << "CPU time      : " << FormatSeconds(e.cpuSeconds)
+              << "  (95%: " << FormatSeconds(e.cpuSecondsLow) << " - " << FormatSeconds(e.cpuSecondsHigh) << ")" << std::endl;
+    std::cout << "Wall time     : " << FormatSeconds(e.wallSeconds)
+              << "  (95%: " << FormatSeconds(e.wallSecondsLow) << " - " << FormatSeconds(e.wallSecondsHigh) << ")" << std::endl;
+    std::cout << "                (95% intervals cover sampling error only)" << std::endl;
+
+    std::error_code ec;
+    std::filesystem::path target = std::filesystem::absolute(archivePath, ec).parent_path();
+    std::filesystem::space_info space = std::filesystem::space(target, ec);
+    if (!ec) {
+        std::cout << "Free at target: " << FormatBytes(static_cast<double>(space.available))
+                  << (space.available >= e.archiveBytesHigh ? "  (fits)" : "  (MAY NOT FIT)") << std::endl;
+    }
+    if (deadlineSeconds > 0) {
+        std::cout << "Deadline      : " << FormatSeconds(deadlineSeconds)
+                  << (e.wallSecondsHigh <= deadlineSeconds ? "  (fits)" : "  (MAY NOT FINISH)") << std::endl;
+    }
+}
+
 } // namespace
 
 void displayProgress(const std::string& currentFile, float currentFileProgress, float generalProgress) {
@@ -66,9 +263,46 @@ void displayProgress(const std::string& currentFile, float currentFileProgress,
 void printUsage() {
     std::cout << "Usage: acfcli <command> [options]"<< std::endl;
     std::cout << "Commands:" << std::endl;
-    std::cout << "  c <archive.acf> <file/dir1> [file/dir2] ... : Create an archive." << std::endl;
+    std::cout << "  c <archive.acf> <file/dir1> [file/dir2] ... : Create an archive (or --files-from instead of paths)." << std::endl;
     std::cout << "  l <archive.acf>                            : List contents of an archive." << std::endl;
     std::cout << "  x <archive.acf> [output_path]              : Extract an archive." << std::endl;
+    std::cout << "  cat <archive.acf> <path>                   : Write one file's content to stdout." << std::endl;
+    std::cout << "  stat <archive.acf> <path>                  : Show one entry's size, CRC and times." << std::endl;
+    std::cout << "  bench-levels <dir1> [dir2] ...             : Compare levels/strategies on a sample of the input." << std::endl;
+    std::cout << "  gc <repository> [--force]                  : Drop chunks no listed manifest references (--force: drop missing manifests)." << std::endl;
+    std::cout << "  repo-add <repository> <manifest.acf>       : List a manifest again, e.g. after moving it." << std::endl;
+    std::cout << "  repo-remove <repository> <manifest.acf>    : Unlist a manifest so gc can drop its chunks." << std::endl;
+    std::cout << "Create options:" << std::endl;
+    std::cout << "  --level=N --strategy=NAME                  : zstd level (default 9) and strategy (fast..btultra2)." << std::endl;
+    std::cout << "  --adapt --target-mbps=N | --deadline=T     : Adapt the level to an input rate or a deadline (s/m/h)." << std::endl;
+    std::cout << "  --min-level=N --max-level=N                : Bounds for --adapt (default 1..19)." << std::endl;
+    std::cout << "  --long[=WLOG] --long-min-mb=N              : Long-range matching for files >= N MB (64), window up to 2^WLOG (31)." << std::endl;
+    std::cout << "  --no-passthrough                           : Recompress .zst inputs instead of storing them as-is." << std::endl;
+    std::cout << "  --no-filters                               : Disable x86/delta/transpose pre-filters." << std::endl;
+    std::cout << "  --order=path|similar|minhash               : Store similar files together (extension, name, size[, content])." << std::endl;
+    std::cout << "  --base <previous.acf>                      : Delta archive: files also in the base are patched from it." << std::endl;
+    std::cout << "  --repo <dir>                               : Store deduplicated chunks in a shared repository, archive as manifest." << std::endl;
+    std::cout << "  --exclude=GLOB[,GLOB] --include=GLOB[,GLOB]: Skip matching paths (and what is below them) / store only matching files." << std::endl;
+    std::cout << "  --ignore-file[=NAME]                       : Honour .gitignore-style NAME files (.acfignore) found during the walk." << std::endl;
+    std::cout << "  --files-from=FILE|- [--null]               : Store exactly the paths listed (one per line or NUL-separated), as read." << std::endl;
+    std::cout << "  --read-order=path|inode|extent             : Read inputs ahead in disk order (HDDs); the archive is unchanged." << std::endl;
+    std::cout << "  --read-ahead=SIZE                          : Bytes read ahead with --read-order (256m)." << std::endl;
+    std::cout << "  --front-index                              : Write the index before the file data, for streaming and sequential media." << std::endl;
+    std::cout << "  --layout-profile <profile.txt>             : Store the files it lists first, in its order (e.g. acfmount --record-profile)." << std::endl;
+    std::cout << "  --store-aligned=GLOB[,GLOB] --align=4k|2m  : Store matching files uncompressed at aligned offsets, for mmap use (4k)." << std::endl;
+    std::cout << "  --estimate[=F]                             : Only estimate size and time from a sampled fraction F (0.02)." << std::endl;
+    std::cout << "Extract options:" << std::endl;
+    std::cout << "  --update[=time|crc]                        : Skip files already on disk with the same size and mtime (or CRC)." << std::endl;
+    std::cout << "  --max-window-mb=N                          : Refuse entries needing a larger decoder window." << std::endl;
+    std::cout << "  --decode-zst                               : Write stored .zst inputs decoded, without the suffix." << std::endl;
+    std::cout << "  --same-permissions                         : Also restore setuid, setgid and sticky bits." << std::endl;
+    std::cout << "  --base <previous.acf>                      : Base of a delta archive, if not next to it under its recorded name." << std::endl;
+    std::cout << "  --repo <dir>                               : Chunk repository of a manifest, if moved from its recorded path." << std::endl;
+    std::cout << "l/cat/stat options:" << std::endl;
+    std::cout << "  --daemon[=SOCKET]                          : Ask a running acfd, which keeps archives open between calls." << std::endl;
+    std::cout << "bench-levels options:" << std::endl;
+    std::cout << "  --levels=1-19|1,3,9 --strategies=a,b       : Combinations to measure." << std::endl;
+    std::cout << "  --sample-mb=N --threads=N --min-mbps=N     : Sample size (64), workers, speed floor for the recommendation (20)." << std::endl;
 }
 
 int main(int argc, char **argv) {
@@ -78,14 +312,25 @@ int main(int argc, char **argv) {
     }
 
     std::string command = argv[1];
-    std::string archivePath = argv[2];
+    CommandLine cl = ParseCommandLine(argc, argv, 2);
+    if (cl.args.empty()) {
+        printUsage();
+        return 1;
+    }
+    std::string archivePath = cl.args[0];
     acf::ACFArchiver archiver;
     archiver.SetCallback(displayProgress);
 
     try {
+        // --daemon[=SOCKET]: answer l/cat/stat through a running acfd instead of opening the archive here.
+        std::unique_ptr<acf::DaemonClient> daemon;
+        if (cl.Has("daemon")) {
+            daemon = std::make_unique<acf::DaemonClient>(cl.Get("daemon").empty() ? acf::DaemonClient::DefaultSocketPath() : cl.Get("daemon"));
+        }
+
         if (command == "l") {
             std::cout << "Listing contents of " << archivePath << ":\n" << std::endl;
-            auto fileList = archiver.List(archivePath);
+            auto fileList = daemon ? daemon->List(archivePath) : archiver.List(archivePath);
             
             std::cout << std::left << std::setw(22) << "DateTime"
                       << std::setw(10) << "Attr"
@@ -99,33 +344,160 @@ int main(int argc, char **argv) {
                 const auto& path = pair.second;
                 std::cout << std::left << std::setw(22) << DosDateTimeToString(entry.filedatetime)
                           << std::setw(10) << AttrToString(entry.fileattribute)
-                          << std::setw(14) << entry.originalSize
+                          << std::setw(14) << DeliveredSize(entry)
                           << std::hex << std::setw(10) << entry.crc32 << std::dec
                           << " " << path << std::endl;
             }
+        } else if (command == "cat" || command == "stat") {
+            if (cl.args.size() != 2) {
+                printUsage();
+                return 1;
+            }
+            const std::string& path = cl.args[1];
+            acf::ArchiveReaderOptions options;
+            options.basePath = cl.Get("base");
+            options.repositoryPath = cl.Get("repo");
+            std::unique_ptr<acf::ArchiveReader> reader;
+            if (!daemon) reader = std::make_unique<acf::ArchiveReader>(archivePath, options);
+
+            if (command == "cat") {
+                std::vector<uint8_t> data = daemon ? daemon->Read(archivePath, path) : reader->Read(path);
+                std::cout.write(reinterpret_cast<const char*>(data.data()), data.size());
+                std::cout.flush();
+                return std::cout ? 0 : 1;
+            }
+            acf::ACFEntryData entry{};
+            if (daemon ? !daemon->Stat(archivePath, path, entry) : !reader->Find(path)) {
+                std::cerr << "Not found in archive: " << path << std::endl;
+                return 1;
+            }
+            if (reader) entry = *reader->Find(path);
+            std::cout << "Path          : " << path << std::endl;
+            std::cout << "Type          : " << (entry.type == acf::EntryType::Directory ? "directory" : "file") << std::endl;
+            std::cout << "Size          : " << DeliveredSize(entry) << std::endl;
+            std::cout << "Stored        : " << entry.compressedSize << std::endl;
+            if (entry.method == acf::CompressionMethod::ZstdPassthrough) {
+                std::cout << "Decoded size  : " << entry.originalSize << " (stored .zst input, read as stored)" << std::endl;
+            }
+            std::cout << "CRC32         : " << std::hex << entry.crc32 << std::dec << std::endl;
+            std::cout << "Modified      : " << DosDateTimeToString(entry.filedatetime) << std::endl;
+            std::cout << "Attributes    : " << AttrToString(entry.fileattribute) << std::endl;
         } else if (command == "c") {
-            if (argc < 4) {
+            const bool fromList = cl.Has("files-from");
+            if (cl.args.size() < 2 && !fromList) {
                 std::cerr << "Error: No input files specified for creation." << std::endl;
                 printUsage();
                 return 1;
             }
-            std::vector<std::string> inputPaths;
-            for (int i = 3; i < argc; ++i) {
-                inputPaths.push_back(argv[i]);
+            if (cl.args.size() > 1 && fromList) {
+                std::cerr << "Error: --files-from replaces the input paths." << std::endl;
+                return 1;
+            }
+            if (fromList && cl.Has("estimate")) {
+                std::cerr << "Error: --estimate walks input paths; it cannot be used with --files-from." << std::endl;
+                return 1;
+            }
+            std::vector<std::string> inputPaths(cl.args.begin() + 1, cl.args.end());
+
+            acf::CompressionProfile profile = ProfileFromOptions(cl);
+            archiver.SetCompressionProfile(profile);
+            if (cl.Has("base")) archiver.SetBaseArchive(cl.Get("base"));
+            if (cl.Has("repo")) archiver.SetRepository(cl.Get("repo"));
+            if (cl.Has("estimate")) {
+                double fraction = cl.Get("estimate").empty() ? 0.02 : std::stod(cl.Get("estimate"));
+                std::cout << "Estimating " << archivePath << " (nothing is written):" << std::endl;
+                PrintEstimate(archiver.Estimate(inputPaths, ".", "", fraction), archivePath, profile.deadlineSeconds);
+                return 0;
+            }
+            if (fromList) {
+                // --files-from=FILE|- [--null]: one path per line (NUL with --null), read as they come.
+                std::ifstream listFile;
+                if (cl.Get("files-from") != "-") {
+                    listFile.open(cl.Get("files-from"));
+                    if (!listFile) throw std::runtime_error("Could not open file list: " + cl.Get("files-from"));
+                }
+                std::istream& list = cl.Get("files-from") == "-" ? std::cin : listFile;
+                const char separator = cl.Has("null") ? '\0' : '\n';
+                archiver.CreateFromList(archivePath, [&](std::string& path) { return static_cast<bool>(std::getline(list, path, separator)); }, ".", "");
+            } else {
+                archiver.Create(archivePath, inputPaths, ".", "");
             }
-            
-            archiver.Create(archivePath, inputPaths, ".", "");
             std::cout << std::endl; // New line after progress bar
             std::cout << "Archive created successfully." << std::endl;
 
+        } else if (command == "bench-levels") {
+            acf::LevelBenchOptions options;
+            if (cl.Has("levels")) options.levels = ParseLevels(cl.Get("levels"));
+            if (cl.Has("strategies")) {
+                options.strategies.clear();
+                for (const auto& name : SplitList(cl.Get("strategies"))) {
+                    options.strategies.push_back(ParseStrategy(name));
+                }
+            }
+            if (cl.Has("sample-mb")) options.sampleBytes = std::stoull(cl.Get("sample-mb")) << 20;
+            if (cl.Has("threads")) options.threads = std::stoul(cl.Get("threads"));
+            double minMBps = cl.Has("min-mbps") ? std::stod(cl.Get("min-mbps")) : 20.0;
+
+            std::cout << "Benchmarking " << options.levels.size() * options.strategies.size()
+                      << " configurations on a " << (options.sampleBytes >> 20) << " MB sample..." << std::endl;
+            auto results = acf::BenchLevels(cl.args, options);
+
+            std::cout << std::left << std::setw(8) << "Level"
+                      << std::setw(12) << "Strategy"
+                      << std::setw(10) << "Ratio"
+                      << std::setw(14) << "Comp MB/s"
+                      << std::setw(14) << "Decomp MB/s"
+                      << "Pareto" << std::endl;
+            std::cout << std::string(64, '-') << std::endl;
+            for (const auto& r : results) {
+                std::cout << std::left << std::fixed
+                          << std::setw(8) << r.level
+                          << std::setw(12) << StrategyName(r.strategy)
+                          << std::setw(10) << std::setprecision(3) << r.ratio
+                          << std::setw(14) << std::setprecision(1) << r.compressMBps
+                          << std::setw(14) << r.decompressMBps
+                          << (r.pareto ? "*" : "") << std::endl;
+            }
+
+            acf::CompressionProfile best = acf::RecommendProfile(results, minMBps);
+            std::cout << std::endl << "Recommended (>= " << minMBps << " MB/s): --level=" << best.level;
+            if (best.strategy != 0) std::cout << " --strategy=" << StrategyName(best.strategy);
+            std::cout << std::endl;
         } else if (command == "x") {
             std::string outputPath = ".";
-            if (argc > 3) {
-                outputPath = argv[3];
+            if (cl.args.size() > 1) {
+                outputPath = cl.args[1];
             }
+            archiver.SetDecodePassthrough(cl.Has("decode-zst"));
+            archiver.SetRestoreSpecialBits(cl.Has("same-permissions"));
+            if (cl.Has("update")) {
+                const std::string update = cl.Get("update");
+                if (update.empty() || update == "time") archiver.SetExtractUpdate(acf::ExtractUpdate::SizeTime);
+                else if (update == "crc") archiver.SetExtractUpdate(acf::ExtractUpdate::Crc);
+                else throw std::runtime_error("Unknown update check: " + update);
+            }
+            if (cl.Has("max-window-mb")) {
+                archiver.SetDecoderMemoryLimit(std::stoull(cl.Get("max-window-mb")) << 20);
+            }
+            if (cl.Has("base")) archiver.SetBaseArchive(cl.Get("base"));
+            if (cl.Has("repo")) archiver.SetRepository(cl.Get("repo"));
             archiver.ExtractAll(archivePath, outputPath);
             std::cout << std::endl; // New line after progress bar
             std::cout << "Archive extracted successfully." << std::endl;
+        } else if (command == "gc") {
+            acf::RepositoryGCStats stats = acf::CollectRepositoryGarbage(archivePath, cl.Has("force"));
+            std::cout << "Manifests     : " << stats.archives << std::endl;
+            if (stats.missingArchives) std::cout << "Dropped       : " << stats.missingArchives << " missing manifests" << std::endl;
+            std::cout << "Live chunks   : " << stats.liveChunks << std::endl;
+            std::cout << "Removed       : " << stats.removedChunks << " chunks, " << FormatBytes(stats.removedBytes)
+                      << " (" << stats.packsRewritten << " packs rewritten)" << std::endl;
+        } else if (command == "repo-add" || command == "repo-remove") {
+            if (cl.args.size() != 2) {
+                printUsage();
+                return 1;
+            }
+            if (command == "repo-add") acf::RegisterRepositoryManifest(archivePath, cl.args[1]);
+            else acf::UnregisterRepositoryManifest(archivePath, cl.args[1]);
         } else {
             std::cerr << "Error: Unknown command '" << command << "'" << std::endl;
             printUsage();
@@ -0,0 +1,468 @@
+// acfd: keeps archives open between requests and answers list, stat and
+// read requests from DaemonClient (acfcli --daemon) over a Unix domain
+// socket. Opened indexes stay in memory until the archive file changes,
+// worker threads keep their zstd contexts, and decoded blocks are shared in
+// one BlockCache.
+#include "acf.hh"
+#include "acfdaemon.hh"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t kDefaultCacheMB = 512;
+constexpr size_t kDefaultMaxArchives = 64;
+constexpr int kDefaultIdleTimeout = 60; // Seconds a connection may wait between requests
+constexpr int kIoTimeout = 30;          // Seconds a started request or response may stall
+// Upper bounds of the latency histogram, in seconds.
+constexpr double kLatencyBuckets[] = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1, 5 };
+const char* const kOperations[] = { "list", "stat", "read", "metrics" };
+constexpr size_t kOperationCount = std::size(kOperations);
+
+std::string g_SocketPath;
+
+void RemoveSocketAndExit(int) {
+    unlink(g_SocketPath.c_str());
+    _exit(0);
+}
+
+class Metrics
+{
+public:
+    void Record(size_t operation, double seconds, bool ok) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Operation& op = m_Operations[operation];
+        ++op.count;
+        if (!ok) ++op.errors;
+        op.sum += seconds;
+        for (size_t i = 0; i < std::size(kLatencyBuckets); ++i) {
+            if (seconds <= kLatencyBuckets[i]) ++op.buckets[i];
+        }
+    }
+
+    void RecordOpen() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        ++m_ArchiveOpens;
+    }
+
+    std::string Format(const acf::BlockCacheStats& cache, size_t archivesOpen) const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::ostringstream out;
+        out << "# HELP acfd_requests_total Requests answered, by operation.\n"
+            << "# TYPE acfd_requests_total counter\n";
+        for (size_t i = 0; i < kOperationCount; ++i) {
+            out << "acfd_requests_total{op=\"" << kOperations[i] << "\"} " << m_Operations[i].count << "\n";
+        }
+        out << "# HELP acfd_request_errors_total Requests answered with an error, by operation.\n"
+            << "# TYPE acfd_request_errors_total counter\n";
+        for (size_t i = 0; i < kOperationCount; ++i) {
+            out << "acfd_request_errors_total{op=\"" << kOperations[i] << "\"} " << m_Operations[i].errors << "\n";
+        }
+        out << "# HELP acfd_request_duration_seconds Time from request to response, by operation.\n"
+            << "# TYPE acfd_request_duration_seconds histogram\n";
+        for (size_t i = 0; i < kOperationCount; ++i) {
+            const Operation& op = m_Operations[i];
+            for (size_t b = 0; b < std::size(kLatencyBuckets); ++b) {
+                out << "acfd_request_duration_seconds_bucket{op=\"" << kOperations[i] << "\",le=\"" << kLatencyBuckets[b] << "\"} " << op.buckets[b] << "\n";
+            }
+            out << "acfd_request_duration_seconds_bucket{op=\"" << kOperations[i] << "\",le=\"+Inf\"} " << op.count << "\n"
+                << "acfd_request_duration_seconds_sum{op=\"" << kOperations[i] << "\"} " << op.sum << "\n"
+                << "acfd_request_duration_seconds_count{op=\"" << kOperations[i] << "\"} " << op.count << "\n";
+        }
+        const uint64_t lookups = cache.hits + cache.misses;
+        out << "# HELP acfd_cache_hits_total Decoded blocks served from the cache.\n"
+            << "# TYPE acfd_cache_hits_total counter\n"
+            << "acfd_cache_hits_total " << cache.hits << "\n"
+            << "# HELP acfd_cache_misses_total Decoded blocks not in the cache.\n"
+            << "# TYPE acfd_cache_misses_total counter\n"
+            << "acfd_cache_misses_total " << cache.misses << "\n"
+            << "# HELP acfd_cache_evictions_total Blocks evicted to stay within the cache size.\n"
+            << "# TYPE acfd_cache_evictions_total counter\n"
+            << "acfd_cache_evictions_total " << cache.evictions << "\n"
+            << "# HELP acfd_cache_hit_ratio Hits over lookups since start.\n"
+            << "# TYPE acfd_cache_hit_ratio gauge\n"
+            << "acfd_cache_hit_ratio " << (lookups ? static_cast<double>(cache.hits) / lookups : 0.0) << "\n"
+            << "# HELP acfd_cache_bytes Decoded bytes held in the cache.\n"
+            << "# TYPE acfd_cache_bytes gauge\n"
+            << "acfd_cache_bytes " << cache.bytes << "\n"
+            << "# HELP acfd_archives_open Archives with a loaded index.\n"
+            << "# TYPE acfd_archives_open gauge\n"
+            << "acfd_archives_open " << archivesOpen << "\n"
+            << "# HELP acfd_archive_opens_total Index loads, including reloads of changed archives.\n"
+            << "# TYPE acfd_archive_opens_total counter\n"
+            << "acfd_archive_opens_total " << m_ArchiveOpens << "\n";
+        return out.str();
+    }
+
+private:
+    struct Operation
+    {
+        uint64_t count = 0;
+        uint64_t errors = 0;
+        double sum = 0;
+        uint64_t buckets[std::size(kLatencyBuckets)] = {};
+    };
+
+    mutable std::mutex m_Mutex;
+    Operation m_Operations[kOperationCount];
+    uint64_t m_ArchiveOpens = 0;
+};
+
+// Open archives by canonical path, reopened when the file's size or
+// modification time changes and closed least recently used first.
+class ArchiveTable
+{
+public:
+    ArchiveTable(std::shared_ptr<acf::BlockCache> cache, size_t maxArchives, Metrics& metrics)
+        : m_Cache(std::move(cache)), m_MaxArchives(maxArchives), m_Metrics(metrics) {}
+
+    std::shared_ptr<const acf::ArchiveReader> Get(const std::string& archivePath) {
+        const std::string key = fs::weakly_canonical(archivePath).string();
+        struct stat st;
+        if (stat(key.c_str(), &st) != 0) {
+            throw std::runtime_error("Could not open archive file: " + archivePath);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto it = m_Archives.find(key);
+        if (it != m_Archives.end() && it->second.size == st.st_size && it->second.mtime == st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec) {
+            it->second.lastUse = ++m_Clock;
+            return it->second.reader;
+        }
+
+        acf::ArchiveReaderOptions options;
+        options.cache = m_Cache;
+        OpenArchive open;
+        open.reader = std::make_shared<acf::ArchiveReader>(key, options);
+        open.size = st.st_size;
+        open.mtime = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+        open.lastUse = ++m_Clock;
+        m_Metrics.RecordOpen();
+        m_Archives[key] = open;
+
+        while (m_Archives.size() > m_MaxArchives) {
+            auto oldest = std::min_element(m_Archives.begin(), m_Archives.end(),
+                                           [](const auto& a, const auto& b) { return a.second.lastUse < b.second.lastUse; });
+            m_Archives.erase(oldest);
+        }
+        return open.reader;
+    }
+
+    size_t Size() const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Archives.size();
+    }
+
+private:
+    struct OpenArchive
+    {
+        std::shared_ptr<const acf::ArchiveReader> reader;
+        off_t size = 0;
+        long long mtime = 0;
+        uint64_t lastUse = 0;
+    };
+
+    std::shared_ptr<acf::BlockCache> m_Cache;
+    size_t m_MaxArchives;
+    Metrics& m_Metrics;
+    mutable std::mutex m_Mutex;
+    std::map<std::string, OpenArchive> m_Archives;
+    uint64_t m_Clock = 0;
+};
+
+class Daemon
+{
+public:
+    Daemon(size_t cacheMB, size_t maxArchives)
+        : m_Cache(std::make_shared<acf::BlockCache>(cacheMB << 20)),
+          m_Archives(m_Cache, maxArchives, m_Metrics) {}
+
+    // Answers the next request on a connection. False once the connection
+    // is closed, broken or timed out; the caller then closes it.
+    bool ServeOne(int sock) {
+        std::vector<std::string> request;
+        return acf::detail::ReceiveRequest(sock, request) && Answer(sock, request);
+    }
+
+private:
+    bool Answer(int sock, const std::vector<std::string>& request) {
+        auto start = std::chrono::steady_clock::now();
+        size_t operation = std::find(std::begin(kOperations), std::end(kOperations), request[0]) - std::begin(kOperations);
+        std::vector<uint8_t> payload;
+        bool ok = true;
+        try {
+            payload = Run(operation, request);
+        } catch (const std::exception& e) {
+            ok = false;
+            payload.assign(e.what(), e.what() + strlen(e.what()));
+        }
+        if (operation < kOperationCount) {
+            m_Metrics.Record(operation, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), ok);
+        }
+        return acf::detail::SendResponse(sock, ok, payload.data(), payload.size());
+    }
+
+    std::vector<uint8_t> Run(size_t operation, const std::vector<std::string>& request) {
+        const std::string op = operation < kOperationCount ? kOperations[operation] : request[0];
+        const size_t fields = op == "metrics" ? 1 : op == "list" ? 2 : 3;
+        if (operation >= kOperationCount) {
+            throw std::runtime_error("Unknown request: " + op);
+        }
+        if (request.size() != fields) {
+            throw std::runtime_error("Malformed request: " + op);
+        }
+
+        if (op == "metrics") {
+            std::string text = m_Metrics.Format(m_Cache->Stats(), m_Archives.Size());
+            return std::vector<uint8_t>(text.begin(), text.end());
+        }
+        auto reader = m_Archives.Get(request[1]);
+        if (op == "list") {
+            return acf::detail::EncodeEntries(reader->Entries());
+        }
+        if (op == "stat") {
+            std::vector<std::pair<acf::ACFEntryData, std::string>> found;
+            if (const acf::ACFEntryData* entry = reader->Find(request[2])) found.emplace_back(*entry, request[2]);
+            return acf::detail::EncodeEntries(found);
+        }
+        return reader->Read(request[2]);
+    }
+
+    Metrics m_Metrics;
+    std::shared_ptr<acf::BlockCache> m_Cache;
+    ArchiveTable m_Archives;
+};
+
+// Bounded set of workers that answer one request at a time from a queue of
+// ready connections, so the zstd contexts of their threads stay warm. A
+// connection goes back to the poll loop after each request, so clients that
+// keep a connection open do not hold on to a worker.
+class WorkerPool
+{
+public:
+    WorkerPool(Daemon& daemon, unsigned threads, std::function<void(int sock)> done) : m_Done(std::move(done)) {
+        for (unsigned i = 0; i < threads; ++i) {
+            m_Threads.emplace_back([this, &daemon] {
+                for (;;) {
+                    int sock;
+                    {
+                        std::unique_lock<std::mutex> lock(m_Mutex);
+                        m_Ready.wait(lock, [this] { return !m_Queue.empty(); });
+                        sock = m_Queue.front();
+                        m_Queue.pop_front();
+                    }
+                    if (daemon.ServeOne(sock)) m_Done(sock);
+                    else close(sock);
+                }
+            });
+        }
+    }
+
+    void Push(int sock) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Queue.push_back(sock);
+        }
+        m_Ready.notify_one();
+    }
+
+private:
+    std::function<void(int sock)> m_Done;
+    std::mutex m_Mutex;
+    std::condition_variable m_Ready;
+    std::deque<int> m_Queue;
+    std::vector<std::thread> m_Threads;
+};
+
+// Accepts connections and watches the idle ones with poll(); a connection
+// with a request waiting is handed to the pool and comes back once it is
+// answered. Connections idle for idleTimeout seconds are closed.
+class ConnectionLoop
+{
+public:
+    ConnectionLoop(int listener, Daemon& daemon, unsigned threads, int idleTimeout)
+        : m_Listener(listener), m_IdleTimeout(idleTimeout),
+          m_Pool(daemon, threads, [this](int sock) { Return(sock); })
+    {
+        if (pipe2(m_Wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+            throw std::runtime_error(std::string("pipe: ") + strerror(errno));
+        }
+    }
+
+    void Run() {
+        std::vector<pollfd> fds;
+        for (;;) {
+            fds.clear();
+            fds.push_back({ m_Listener, POLLIN, 0 });
+            fds.push_back({ m_Wake[0], POLLIN, 0 });
+            for (const auto& [sock, since] : m_Idle) fds.push_back({ sock, POLLIN, 0 });
+            if (poll(fds.data(), fds.size(), 1000) < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("poll: ") + strerror(errno));
+            }
+            const auto now = std::chrono::steady_clock::now();
+
+            for (size_t i = 2; i < fds.size(); ++i) {
+                const int sock = fds[i].fd;
+                if (fds[i].revents) {
+                    // A request, or a hangup the worker's read will notice.
+                    m_Idle.erase(sock);
+                    m_Pool.Push(sock);
+                } else if (now - m_Idle[sock] >= std::chrono::seconds(m_IdleTimeout)) {
+                    m_Idle.erase(sock);
+                    close(sock);
+                }
+            }
+            if (fds[1].revents) {
+                char drain[64];
+                while (read(m_Wake[0], drain, sizeof(drain)) > 0) {}
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                for (int sock : m_Returned) m_Idle[sock] = now;
+                m_Returned.clear();
+            }
+            if (fds[0].revents) Accept(now);
+        }
+    }
+
+private:
+    void Accept(std::chrono::steady_clock::time_point now) {
+        int client = accept4(m_Listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) return;
+            throw std::runtime_error(std::string("accept: ") + strerror(errno));
+        }
+        // A client that stops in the middle of a request or response only
+        // holds its worker until the timeout.
+        timeval timeout{ kIoTimeout, 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        m_Idle[client] = now;
+    }
+
+    // Called by a worker once a request is answered.
+    void Return(int sock) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Returned.push_back(sock);
+        }
+        const char wake = 0;
+        (void)!write(m_Wake[1], &wake, 1);
+    }
+
+    int m_Listener;
+    int m_IdleTimeout;
+    int m_Wake[2] = { -1, -1 };
+    std::map<int, std::chrono::steady_clock::time_point> m_Idle; // Poll thread only
+    std::mutex m_Mutex;
+    std::vector<int> m_Returned;
+    WorkerPool m_Pool;
+};
+
+int Listen(const std::string& socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + socketPath);
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    // A socket file nobody answers on is left over from an earlier run.
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+        close(probe);
+        throw std::runtime_error("acfd is already running on " + socketPath);
+    }
+    close(probe);
+    unlink(socketPath.c_str());
+
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    mode_t mask = umask(0077); // Only the owner may connect
+    int bound = bind(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    umask(mask);
+    if (sock < 0 || bound != 0 || listen(sock, SOMAXCONN) != 0) {
+        throw std::runtime_error("Could not listen on " + socketPath + ": " + strerror(errno));
+    }
+    return sock;
+}
+
+void PrintUsage() {
+    std::cout << "Usage: acfd [options]" << std::endl;
+    std::cout << "       acfd --metrics [--socket=PATH]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --socket=PATH                              : Unix socket (" << acf::DaemonClient::DefaultSocketPath() << ")." << std::endl;
+    std::cout << "  --threads=N                                : Worker threads (one per core)." << std::endl;
+    std::cout << "  --cache-mb=N                               : Decoded block cache shared by all archives (512)." << std::endl;
+    std::cout << "  --max-archives=N                           : Archives kept open (64)." << std::endl;
+    std::cout << "  --idle-timeout=S                           : Close connections idle for S seconds (60)." << std::endl;
+    std::cout << "  --metrics                                  : Print the metrics of a running daemon and exit." << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string socketPath = acf::DaemonClient::DefaultSocketPath();
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t cacheMB = kDefaultCacheMB, maxArchives = kDefaultMaxArchives;
+    int idleTimeout = kDefaultIdleTimeout;
+    bool metrics = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            std::string name = arg.substr(0, arg.find('='));
+            std::string value = arg.find('=') != std::string::npos ? arg.substr(arg.find('=') + 1) : "";
+            if (name == "--socket") socketPath = value;
+            else if (name == "--threads") threads = std::max(1, std::stoi(value));
+            else if (name == "--cache-mb") cacheMB = std::stoull(value);
+            else if (name == "--max-archives") maxArchives = std::max<size_t>(1, std::stoull(value));
+            else if (name == "--idle-timeout") idleTimeout = std::max(1, std::stoi(value));
+            else if (name == "--metrics") metrics = true;
+            else { PrintUsage(); return name == "--help" || name == "-h" ? 0 : 1; }
+        }
+
+        if (metrics) {
+            acf::DaemonClient client(socketPath);
+            std::cout << client.Metrics();
+            return 0;
+        }
+
+        Daemon daemon(cacheMB, maxArchives);
+        int listener = Listen(socketPath);
+        g_SocketPath = socketPath;
+        signal(SIGINT, RemoveSocketAndExit);
+        signal(SIGTERM, RemoveSocketAndExit);
+        signal(SIGPIPE, SIG_IGN);
+        ConnectionLoop loop(listener, daemon, threads, idleTimeout);
+        std::cout << "acfd listening on " << socketPath << std::endl;
+        loop.Run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
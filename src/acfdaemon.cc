@@ -0,0 +1,227 @@
+#include "acf.hh"
+#include "acfdaemon.hh"
+#include "acfinternal.hh"
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifndef _WIN32
+namespace {
+
+bool WriteAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool ReadAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+#endif
+
+namespace acf::detail
+{
+  std::vector<uint8_t> EncodeEntries(const std::vector<std::pair<ACFEntryData, std::string>>& entries)
+  {
+    std::vector<uint8_t> out(sizeof(uint64_t));
+    const uint64_t count = entries.size();
+    memcpy(out.data(), &count, sizeof(count));
+    for (const auto& [entry, path] : entries) {
+        ACFEntryData record = entry;
+        record.pathLength = static_cast<uint16_t>(path.size());
+        const uint8_t* record_ptr = reinterpret_cast<const uint8_t*>(&record);
+        out.insert(out.end(), record_ptr, record_ptr + sizeof(ACFEntryData));
+        out.insert(out.end(), path.begin(), path.end());
+    }
+    return out;
+  }
+
+  std::vector<std::pair<ACFEntryData, std::string>> DecodeEntries(const uint8_t* data, size_t size)
+  {
+    if (size < sizeof(uint64_t)) {
+        throw std::runtime_error("Malformed entry list from daemon");
+    }
+    ACFHeader header;
+    memcpy(&header.entryCount, data, sizeof(uint64_t));
+    header.entrySize = sizeof(ACFEntryData);
+    return ParseCentralDirectory(reinterpret_cast<const char*>(data) + sizeof(uint64_t), size - sizeof(uint64_t), header);
+  }
+
+#ifndef _WIN32
+  bool SendRequest(int fd, const std::vector<std::string>& fields)
+  {
+    std::vector<char> message(sizeof(uint32_t));
+    const uint32_t count = static_cast<uint32_t>(fields.size());
+    memcpy(message.data(), &count, sizeof(count));
+    for (const auto& field : fields) {
+        const uint32_t length = static_cast<uint32_t>(field.size());
+        const char* length_ptr = reinterpret_cast<const char*>(&length);
+        message.insert(message.end(), length_ptr, length_ptr + sizeof(length));
+        message.insert(message.end(), field.begin(), field.end());
+    }
+    return WriteAll(fd, message.data(), message.size());
+  }
+
+  bool ReceiveRequest(int fd, std::vector<std::string>& fields)
+  {
+    uint32_t count;
+    if (!ReadAll(fd, &count, sizeof(count)) || count == 0 || count > kDaemonMaxFields) return false;
+    fields.assign(count, std::string());
+    for (auto& field : fields) {
+        uint32_t length;
+        if (!ReadAll(fd, &length, sizeof(length)) || length > kDaemonMaxField) return false;
+        field.resize(length);
+        if (length && !ReadAll(fd, field.data(), length)) return false;
+    }
+    return true;
+  }
+
+  bool SendResponse(int fd, bool ok, const void* data, size_t size)
+  {
+    char head[1 + sizeof(uint64_t)];
+    head[0] = ok ? 0 : 1;
+    const uint64_t length = size;
+    memcpy(head + 1, &length, sizeof(length));
+    return WriteAll(fd, head, sizeof(head)) && WriteAll(fd, data, size);
+  }
+
+  bool ReceiveResponse(int fd, bool& ok, std::vector<uint8_t>& payload)
+  {
+    char head[1 + sizeof(uint64_t)];
+    if (!ReadAll(fd, head, sizeof(head))) return false;
+    ok = head[0] == 0;
+    uint64_t length;
+    memcpy(&length, head + 1, sizeof(length));
+    payload.resize(static_cast<size_t>(length));
+    return ReadAll(fd, payload.data(), payload.size());
+  }
+#endif
+
+} // namespace acf::detail
+
+namespace acf
+{
+  std::string DaemonClient::DefaultSocketPath()
+  {
+    if (const char* path = std::getenv("ACFD_SOCKET")) {
+        if (*path) return path;
+    }
+#ifdef _WIN32
+    return std::string();
+#else
+    if (const char* runtime = std::getenv("XDG_RUNTIME_DIR")) {
+        if (*runtime) return std::string(runtime) + "/acfd.sock";
+    }
+    return "/tmp/acfd-" + std::to_string(getuid()) + ".sock";
+#endif
+  }
+
+#ifdef _WIN32
+  DaemonClient::DaemonClient(const std::string&) {
+    throw std::runtime_error("acfd is not available on Windows");
+  }
+
+  DaemonClient::~DaemonClient() {}
+
+  std::vector<uint8_t> DaemonClient::Call(const std::vector<std::string>&) {
+    throw std::runtime_error("acfd is not available on Windows");
+  }
+#else
+  DaemonClient::DaemonClient(const std::string& socketPath) : m_SocketPath(socketPath)
+  {
+    Connect();
+  }
+
+  DaemonClient::~DaemonClient() {
+    if (m_Socket >= 0) close(m_Socket);
+  }
+
+  void DaemonClient::Connect()
+  {
+    if (m_Socket >= 0) close(m_Socket);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (m_SocketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + m_SocketPath);
+    }
+    memcpy(address.sun_path, m_SocketPath.c_str(), m_SocketPath.size() + 1);
+    m_Socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_Socket < 0 || connect(m_Socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        const std::string reason = strerror(errno);
+        if (m_Socket >= 0) close(m_Socket);
+        m_Socket = -1;
+        throw std::runtime_error("Could not connect to acfd at " + m_SocketPath + ": " + reason);
+    }
+  }
+
+  std::vector<uint8_t> DaemonClient::Call(const std::vector<std::string>& request)
+  {
+    bool ok = false;
+    std::vector<uint8_t> payload;
+    // acfd closes idle connections; every request is safe to send again.
+    bool sent = m_Socket >= 0 && detail::SendRequest(m_Socket, request) && detail::ReceiveResponse(m_Socket, ok, payload);
+    if (!sent) {
+        Connect();
+        sent = detail::SendRequest(m_Socket, request) && detail::ReceiveResponse(m_Socket, ok, payload);
+    }
+    if (!sent) {
+        throw std::runtime_error("Connection to acfd lost");
+    }
+    if (!ok) {
+        throw std::runtime_error(std::string(payload.begin(), payload.end()));
+    }
+    return payload;
+  }
+#endif
+
+  std::vector<std::pair<ACFEntryData, std::string>> DaemonClient::List(const std::string& archivePath) {
+    std::vector<uint8_t> payload = Call({ "list", fs::absolute(archivePath).string() });
+    return detail::DecodeEntries(payload.data(), payload.size());
+  }
+
+  bool DaemonClient::Stat(const std::string& archivePath, const std::string& path, ACFEntryData& entry) {
+    std::vector<uint8_t> payload = Call({ "stat", fs::absolute(archivePath).string(), path });
+    auto entries = detail::DecodeEntries(payload.data(), payload.size());
+    if (entries.empty()) return false;
+    entry = entries[0].first;
+    return true;
+  }
+
+  std::vector<uint8_t> DaemonClient::Read(const std::string& archivePath, const std::string& path) {
+    return Call({ "read", fs::absolute(archivePath).string(), path });
+  }
+
+  std::string DaemonClient::Metrics() {
+    std::vector<uint8_t> payload = Call({ "metrics" });
+    return std::string(payload.begin(), payload.end());
+  }
+
+} // namespace acf
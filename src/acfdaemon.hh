@@ -0,0 +1,27 @@
+#pragma once
+#include "acf.hh"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+// Wire format between acfd and DaemonClient over a Unix domain socket. A
+// request is a list of fields: uint32 count, then per field uint32 length
+// and the bytes; the first field names the operation. A response is uint8
+// status (0 = ok, else the payload is an error message), uint64 length and
+// the payload. Integers are in host order; both ends share one machine.
+namespace acf::detail
+{
+  constexpr uint32_t kDaemonMaxFields = 16;
+  constexpr uint32_t kDaemonMaxField = 1 << 16;
+
+  bool SendRequest(int fd, const std::vector<std::string>& fields);
+  bool ReceiveRequest(int fd, std::vector<std::string>& fields);
+  bool SendResponse(int fd, bool ok, const void* data, size_t size);
+  bool ReceiveResponse(int fd, bool& ok, std::vector<uint8_t>& payload);
+
+  // Entry lists travel as uint64 count followed by central directory records.
+  std::vector<uint8_t> EncodeEntries(const std::vector<std::pair<ACFEntryData, std::string>>& entries);
+  std::vector<std::pair<ACFEntryData, std::string>> DecodeEntries(const uint8_t* data, size_t size);
+
+} // namespace acf::detail
@@ -0,0 +1,219 @@
+#include "acffilter.hh"
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+using acf::FilterType;
+
+uint32_t ReadLE32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void WriteLE32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+// --- x86 Branch Filter ---
+// Converts the rel32 operand of E8 (call) and E9 (jmp) into an absolute
+// position, so repeated calls to one target become repeated byte strings.
+// Only operands within +/-16 MiB (top byte 00 or FF) are converted, and the
+// result is wrapped into the same range, so the decoder can make the same
+// decision from the filtered bytes. Every E8/E9 skips its 4 operand bytes
+// whether converted or not, which keeps both sides on the same positions.
+class X86Filter : public acf::detail::Filter
+{
+public:
+    explicit X86Filter(bool encode) : m_Encode(encode) {}
+
+    void Process(const uint8_t* data, size_t size, bool final, std::vector<uint8_t>& out) override {
+        m_Pending.insert(m_Pending.end(), data, data + size);
+        const size_t n = m_Pending.size();
+        size_t i = 0;
+        while (i + 5 <= n) {
+            const uint8_t op = m_Pending[i];
+            if (op != 0xE8 && op != 0xE9) { ++i; continue; }
+            uint8_t* operand = &m_Pending[i + 1];
+            if (operand[3] == 0x00 || operand[3] == 0xFF) {
+                const uint32_t pos = static_cast<uint32_t>(m_Pos + i);
+                const uint32_t value = ReadLE32(operand);
+                uint32_t converted = (m_Encode ? value + pos : value - pos) & 0x01FFFFFF;
+                if (converted & 0x01000000) converted |= 0xFE000000; // Sign-extend the 25-bit result
+                WriteLE32(operand, converted);
+            }
+            i += 5;
+        }
+
+        // Up to four undecided bytes wait for the next call.
+        size_t emit = final ? n : i;
+        out.insert(out.end(), m_Pending.begin(), m_Pending.begin() + emit);
+        m_Pending.erase(m_Pending.begin(), m_Pending.begin() + emit);
+        m_Pos += emit;
+    }
+
+private:
+    bool m_Encode;
+    uint64_t m_Pos = 0; // Stream offset of m_Pending[0]
+    std::vector<uint8_t> m_Pending;
+};
+
+// --- Delta Filter ---
+// Stores each byte as the difference to the byte `distance` positions earlier,
+// turning slowly changing columns of numeric tables into runs of small values.
+class DeltaFilter : public acf::detail::Filter
+{
+public:
+    DeltaFilter(uint8_t distance, bool encode) : m_Encode(encode), m_History(std::max<uint8_t>(distance, 1), 0) {}
+
+    void Process(const uint8_t* data, size_t size, bool /*final*/, std::vector<uint8_t>& out) override {
+        const size_t distance = m_History.size();
+        size_t start = out.size();
+        out.resize(start + size);
+        for (size_t i = 0; i < size; ++i) {
+            uint8_t& prev = m_History[m_Index];
+            if (m_Encode) {
+                out[start + i] = static_cast<uint8_t>(data[i] - prev);
+                prev = data[i];
+            } else {
+                out[start + i] = static_cast<uint8_t>(data[i] + prev);
+                prev = out[start + i];
+            }
+            if (++m_Index == distance) m_Index = 0;
+        }
+    }
+
+private:
+    bool m_Encode;
+    std::vector<uint8_t> m_History;
+    size_t m_Index = 0;
+};
+
+// --- Transpose Filter ---
+// Regroups fixed-size records by byte position (all first bytes, then all
+// second bytes, ...) within blocks, so each column compresses on its own.
+class TransposeFilter : public acf::detail::Filter
+{
+public:
+    static constexpr size_t kBlock = 256 << 10;
+
+    TransposeFilter(uint8_t stride, bool encode)
+        : m_Encode(encode), m_Stride(std::max<uint8_t>(stride, 1)),
+          m_BlockSize(m_Stride * std::max<size_t>(1, kBlock / m_Stride)) {}
+
+    void Process(const uint8_t* data, size_t size, bool final, std::vector<uint8_t>& out) override {
+        m_Pending.insert(m_Pending.end(), data, data + size);
+        size_t pos = 0;
+        while (m_Pending.size() - pos >= m_BlockSize) {
+            Transform(&m_Pending[pos], m_BlockSize, out);
+            pos += m_BlockSize;
+        }
+        if (final && pos < m_Pending.size()) {
+            // Last block: whole records are transposed, a partial record is kept as-is.
+            size_t len = m_Pending.size() - pos;
+            size_t whole = (len / m_Stride) * m_Stride;
+            Transform(&m_Pending[pos], whole, out);
+            out.insert(out.end(), m_Pending.begin() + pos + whole, m_Pending.end());
+            pos = m_Pending.size();
+        }
+        m_Pending.erase(m_Pending.begin(), m_Pending.begin() + pos);
+    }
+
+private:
+    void Transform(const uint8_t* in, size_t len, std::vector<uint8_t>& out) {
+        const size_t records = len / m_Stride;
+        size_t start = out.size();
+        out.resize(start + len);
+        uint8_t* dst = &out[start];
+        for (size_t r = 0; r < records; ++r) {
+            for (size_t c = 0; c < m_Stride; ++c) {
+                if (m_Encode) {
+                    dst[c * records + r] = in[r * m_Stride + c];
+                } else {
+                    dst[r * m_Stride + c] = in[c * records + r];
+                }
+            }
+        }
+    }
+
+    bool m_Encode;
+    size_t m_Stride;
+    size_t m_BlockSize;
+    std::vector<uint8_t> m_Pending;
+};
+
+// --- Sniffing ---
+bool IsX86Executable(const uint8_t* data, size_t size) {
+    if (size >= 20 && memcmp(data, "\x7F" "ELF", 4) == 0) {
+        uint16_t machine = static_cast<uint16_t>(data[18] | (data[19] << 8));
+        return machine == 3 || machine == 62; // EM_386, EM_X86_64
+    }
+    if (size >= 64 && data[0] == 'M' && data[1] == 'Z') {
+        uint32_t peOffset = ReadLE32(data + 0x3C);
+        if (peOffset <= size - 6 && memcmp(data + peOffset, "PE\0\0", 4) == 0) {
+            uint16_t machine = static_cast<uint16_t>(data[peOffset + 4] | (data[peOffset + 5] << 8));
+            return machine == 0x14C || machine == 0x8664; // i386, AMD64
+        }
+    }
+    return false;
+}
+
+size_t TrialSize(const uint8_t* data, size_t size, FilterType type, uint8_t param, std::vector<uint8_t>& scratch) {
+    std::vector<uint8_t> filtered;
+    const uint8_t* src = data;
+    if (type != FilterType::None) {
+        filtered.reserve(size);
+        acf::detail::CreateFilter(type, param, true)->Process(data, size, true, filtered);
+        src = filtered.data();
+    }
+    scratch.resize(ZSTD_compressBound(size));
+    size_t csize = ZSTD_compress(scratch.data(), scratch.size(), src, size, 1);
+    return ZSTD_isError(csize) ? size : csize;
+}
+
+} // namespace
+
+namespace acf::detail
+{
+  std::unique_ptr<Filter> CreateFilter(FilterType type, uint8_t param, bool encode)
+  {
+    switch (type) {
+        case FilterType::X86: return std::make_unique<X86Filter>(encode);
+        case FilterType::Delta: return std::make_unique<DeltaFilter>(param, encode);
+        case FilterType::Transpose: return std::make_unique<TransposeFilter>(param, encode);
+        default: return nullptr;
+    }
+  }
+
+  FilterType SniffFilter(const uint8_t* data, size_t size, uint8_t& param)
+  {
+    constexpr size_t kMinSniff = 16 << 10;
+    constexpr size_t kMaxSniff = 64 << 10;
+    param = 0;
+    if (IsX86Executable(data, size)) return FilterType::X86;
+    if (size < kMinSniff) return FilterType::None;
+
+    // Structured data is recognised by trial: a candidate must beat plain
+    // zstd level 1 on the sample by at least 5% to be worth the extra pass.
+    size = std::min(size, kMaxSniff);
+    std::vector<uint8_t> scratch;
+    size_t best = TrialSize(data, size, FilterType::None, 0, scratch) * 95 / 100;
+    FilterType bestType = FilterType::None;
+
+    static const uint8_t kDeltaDistances[] = { 1, 2, 3, 4, 8 };
+    static const uint8_t kTransposeStrides[] = { 2, 3, 4, 6, 8, 12, 16 };
+    for (uint8_t d : kDeltaDistances) {
+        size_t csize = TrialSize(data, size, FilterType::Delta, d, scratch);
+        if (csize < best) { best = csize; bestType = FilterType::Delta; param = d; }
+    }
+    for (uint8_t s : kTransposeStrides) {
+        size_t csize = TrialSize(data, size, FilterType::Transpose, s, scratch);
+        if (csize < best) { best = csize; bestType = FilterType::Transpose; param = s; }
+    }
+    return bestType;
+  }
+
+} // namespace acf::detail
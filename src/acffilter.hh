@@ -0,0 +1,27 @@
+#pragma once
+#include "acf.hh"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Reversible preprocessing filters applied to file content before zstd.
+namespace acf::detail
+{
+  class Filter
+  {
+  public:
+    virtual ~Filter() = default;
+    // Transforms the next part of the stream and appends the result to `out`.
+    // Bytes that cannot be decided yet are held back until more input arrives
+    // or `final` is set; output length always equals input length in total.
+    virtual void Process(const uint8_t* data, size_t size, bool final, std::vector<uint8_t>& out) = 0;
+  };
+
+  std::unique_ptr<Filter> CreateFilter(FilterType type, uint8_t param, bool encode);
+
+  // Picks a filter from the first bytes of a file: x86 for ELF/PE executables,
+  // Delta or Transpose for data with a fixed record stride, None otherwise.
+  FilterType SniffFilter(const uint8_t* data, size_t size, uint8_t& param);
+
+} // namespace acf::detail
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <memory>
+#include "acf.hh"
+
+// Helpers shared between the libacf translation units. Not part of the public API.
+namespace acf::detail
+{
+  constexpr int kDefaultWindowLogMax = 27; // zstd's decoder limit when none is set
+
+  // Expands input files and directories (recursively) into sorted lists of
+  // regular files and directories, each path listed once. Only the walk
+  // filter of filter (include, exclude, ignoreFileName) is used.
+  void CollectInputs(const std::vector<std::string>& inputPaths,
+                     std::vector<std::filesystem::path>& files,
+                     std::vector<std::filesystem::path>& dirs,
+                     const CompressionProfile& filter = CompressionProfile());
+
+  uint32_t Crc32Update(uint32_t crc, const void* data, size_t len);
+
+  // Internal path with legacy '\\' separators replaced by '/'.
+  std::string NormalizeInternalPath(const std::string& path);
+  // False for a path that would leave the directory it is extracted to:
+  // absolute ('/' or a drive letter at the start) or with a ".." component.
+  bool IsSafeInternalPath(const std::string& path);
+  // Entries of a central directory already read and CRC checked.
+  std::vector<std::pair<ACFEntryData, std::string>> ParseCentralDirectory(const char* data, size_t size,
+                                                                          const ACFHeader& header);
+  // Base archive of a delta archive: overridePath if given, else the recorded
+  // name next to the archive. Throws unless it is the recorded base.
+  std::string ResolveBaseArchive(const ACFBaseRecord& record, const std::string& name,
+                                 const std::string& archivePath, const std::string& overridePath);
+  // Repository path of a manifest; relative records are relative to the manifest.
+  std::string RecordedRepositoryPath(const std::string& recorded, const std::string& archivePath);
+
+  // Archive path of a host file or directory: relative to basePath, prefixed
+  // with internalBasePath, '/' separated, directories with a trailing '/'.
+  std::string InternalPathFor(const std::filesystem::path& p,
+                              const std::filesystem::path& basePath,
+                              const std::string& internalBasePath,
+                              bool isDirectory);
+
+  // Shell-style match of an archive path: '*' and '?' do not cross '/',
+  // '**' does. A pattern without '/' is matched against the file name only.
+  bool GlobMatch(const std::string& pattern, const std::string& path);
+
+  // Bytes read from one input file for sampling, and how many input bytes each
+  // sampled byte stands for.
+  struct InputSample
+  {
+    std::vector<uint8_t> data;
+    double weight = 1.0;
+  };
+
+  // Takes about sampleBytes from the files, spread over strata of
+  // (extension, size class) in proportion to each stratum's share of the input.
+  std::vector<InputSample> SampleInputs(const std::vector<std::filesystem::path>& files,
+                                        uint64_t sampleBytes);
+
+  // Position of a file in the processing order of Create(). Files sharing a
+  // group are expected to be similar and are stored next to each other.
+  struct OrderedInput
+  {
+    size_t index; // Into the collected file list
+    size_t group;
+  };
+
+  // Processing order for the collected files. FileOrder::Path keeps the list
+  // as-is, with every file in a group of its own.
+  std::vector<OrderedInput> OrderInputs(const std::vector<std::filesystem::path>& files, FileOrder order);
+
+  // Reads the inputs of Create() ahead of it on a background thread, a batch
+  // of about half of windowBytes at a time, each batch in disk order. Create()
+  // then finds them in the page cache; what it stores is unaffected.
+  class ReadAhead
+  {
+  public:
+    // files in the order Create() processes them.
+    ReadAhead(std::vector<std::filesystem::path> files, ReadOrder order, uint64_t windowBytes);
+    ~ReadAhead();
+    ReadAhead(const ReadAhead&) = delete;
+    ReadAhead& operator=(const ReadAhead&) = delete;
+
+    // Create() has moved on to files[position].
+    void Advance(size_t position);
+
+  private:
+    struct State;
+    std::unique_ptr<State> m_State;
+  };
+
+} // namespace acf::detail
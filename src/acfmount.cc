@@ -0,0 +1,360 @@
+// acfmount: an ACF archive as a read-only FUSE filesystem (Linux).
+//
+// The handlers below only depend on POSIX types; the FUSE glue at the end
+// forwards to them. --self-test drives the same handlers from several
+// threads without a kernel mount, so they can be checked where FUSE is not
+// available.
+#include "acf.hh"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef ACF_HAVE_FUSE
+#define FUSE_USE_VERSION 31
+#include <fuse.h>
+#endif
+
+namespace {
+
+constexpr size_t kDefaultCacheMB = 256;
+constexpr size_t kKernelReadSize = 128 << 10; // Request size of the self-test, as the kernel issues them
+
+time_t DosDateTimeToTime(uint32_t dosDateTime) {
+    if (dosDateTime == 0) return 0;
+    struct tm tm = {};
+    tm.tm_year = ((dosDateTime >> 25) & 0x7F) + 80;
+    tm.tm_mon = ((dosDateTime >> 21) & 0x0F) - 1;
+    tm.tm_mday = (dosDateTime >> 16) & 0x1F;
+    tm.tm_hour = (dosDateTime >> 11) & 0x1F;
+    tm.tm_min = (dosDateTime >> 5) & 0x3F;
+    tm.tm_sec = (dosDateTime & 0x1F) * 2;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+// Open file of the mount. The kernel may issue reads on one handle from
+// several threads; an ArchiveFile serves one at a time.
+struct OpenFile
+{
+    std::mutex mutex;
+    std::unique_ptr<acf::ArchiveFile> file;
+};
+
+// Filesystem operations over an ArchiveVfs. They return 0 or a byte count
+// on success and -errno on failure, and are safe to call from any thread.
+class MountFs
+{
+public:
+    MountFs(const std::string& archivePath, const acf::ArchiveReaderOptions& options)
+        : m_Cache(options.cache),
+          m_Vfs(std::make_shared<acf::ArchiveReader>(archivePath, options)),
+          m_Uid(getuid()), m_Gid(getgid()) {}
+
+    int GetAttr(const char* path, struct stat* st) const {
+        acf::VfsStat vst;
+        if (!m_Vfs.Stat(path, vst)) return -ENOENT;
+        FillStat(vst, st);
+        return 0;
+    }
+
+    using Filler = std::function<void(const char* name, const struct stat* st)>;
+
+    int ReadDir(const char* path, const Filler& fill) const {
+        acf::VfsStat vst;
+        if (!m_Vfs.Stat(path, vst)) return -ENOENT;
+        if (!vst.directory) return -ENOTDIR;
+        struct stat st;
+        FillStat(vst, &st);
+        fill(".", &st);
+        fill("..", nullptr);
+        for (const auto& entry : m_Vfs.ReadDir(path)) {
+            FillStat(entry.stat, &st);
+            fill(entry.name.c_str(), &st);
+        }
+        return 0;
+    }
+
+    int Open(const char* path, int flags, uint64_t& handle) const {
+        if ((flags & O_ACCMODE) != O_RDONLY) return -EROFS;
+        acf::VfsStat vst;
+        if (!m_Vfs.Stat(path, vst)) return -ENOENT;
+        if (vst.directory) return -EISDIR;
+        try {
+            auto open = std::make_unique<OpenFile>();
+            open->file = m_Vfs.Open(path);
+            handle = reinterpret_cast<uint64_t>(open.release());
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << "acfmount: " << path << ": " << e.what() << std::endl;
+            return -EIO;
+        }
+    }
+
+    int Read(uint64_t handle, char* buffer, size_t size, off_t offset) const {
+        OpenFile* open = reinterpret_cast<OpenFile*>(handle);
+        std::lock_guard<std::mutex> lock(open->mutex);
+        try {
+            return static_cast<int>(open->file->Read(static_cast<uint64_t>(offset), buffer, size));
+        } catch (const std::exception& e) {
+            std::cerr << "acfmount: read: " << e.what() << std::endl;
+            return -EIO;
+        }
+    }
+
+    int Release(uint64_t handle) const {
+        delete reinterpret_cast<OpenFile*>(handle);
+        return 0;
+    }
+
+    const acf::ArchiveVfs& Vfs() const { return m_Vfs; }
+    const std::shared_ptr<acf::BlockCache>& Cache() const { return m_Cache; }
+
+private:
+    void FillStat(const acf::VfsStat& vst, struct stat* st) const {
+        memset(st, 0, sizeof(*st));
+        mode_t perms = vst.unixMode ? (vst.unixMode & 0777) : (vst.directory ? 0755 : 0644);
+        perms &= ~0222;
+        st->st_mode = (vst.directory ? S_IFDIR : S_IFREG) | perms;
+        st->st_nlink = vst.directory ? 2 : 1;
+        st->st_uid = m_Uid;
+        st->st_gid = m_Gid;
+        st->st_size = static_cast<off_t>(vst.size);
+        st->st_blksize = acf::BlockCache::kBlockSize;
+        st->st_blocks = static_cast<blkcnt_t>((vst.size + 511) / 512);
+        st->st_mtime = st->st_ctime = st->st_atime = DosDateTimeToTime(vst.filedatetime);
+    }
+
+    std::shared_ptr<acf::BlockCache> m_Cache;
+    acf::ArchiveVfs m_Vfs;
+    uid_t m_Uid;
+    gid_t m_Gid;
+};
+
+// --- Self Test ---
+// Walks the tree with the handlers, then reads every file twice on
+// `threads` threads in kernel-sized requests, the second time mostly from
+// the block cache, and compares with a whole-file read of an uncached reader.
+int SelfTest(const MountFs& fs, const acf::ArchiveReader& reference, unsigned threads) {
+    std::vector<std::pair<std::string, uint64_t>> files;
+    std::function<void(const std::string&)> walk = [&](const std::string& dir) {
+        std::vector<std::string> names;
+        int err = fs.ReadDir(dir.c_str(), [&](const char* name, const struct stat*) {
+            if (strcmp(name, ".") && strcmp(name, "..")) names.push_back(name);
+        });
+        if (err) throw std::runtime_error("readdir " + dir + ": " + strerror(-err));
+        for (const auto& name : names) {
+            std::string path = (dir == "/" ? "" : dir) + "/" + name;
+            struct stat st;
+            if ((err = fs.GetAttr(path.c_str(), &st)) != 0) throw std::runtime_error("getattr " + path + ": " + strerror(-err));
+            if (S_ISDIR(st.st_mode)) walk(path);
+            else files.emplace_back(path, static_cast<uint64_t>(st.st_size));
+        }
+    };
+    walk("/");
+
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<size_t> failures{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            std::vector<char> buffer(kKernelReadSize);
+            for (size_t i; (i = next++) < 2 * files.size();) {
+                const auto& [path, size] = files[i % files.size()];
+                std::vector<uint8_t> data;
+                uint64_t handle = 0;
+                int err = fs.Open(path.c_str(), O_RDONLY, handle);
+                if (!err) {
+                    for (off_t offset = 0;;) {
+                        int n = fs.Read(handle, buffer.data(), buffer.size(), offset);
+                        if (n <= 0) { err = n; break; }
+                        data.insert(data.end(), buffer.data(), buffer.data() + n);
+                        offset += n;
+                    }
+                    fs.Release(handle);
+                }
+                bool ok = !err && data.size() == size;
+                if (ok) {
+                    try {
+                        ok = data == reference.Read(path.substr(1));
+                    } catch (const std::exception&) {
+                        ok = false;
+                    }
+                }
+                if (!ok) {
+                    std::cerr << "FAILED: " << path << (err ? std::string(": ") + strerror(-err) : std::string()) << std::endl;
+                    ++failures;
+                }
+                bytes += data.size();
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << files.size() << " files, " << bytes << " bytes read on " << threads << " threads in "
+              << std::fixed << std::setprecision(2) << seconds << " s";
+    if (auto& cache = fs.Cache()) {
+        acf::BlockCacheStats stats = cache->Stats();
+        std::cout << " (cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                  << stats.evictions << " evictions)";
+    }
+    std::cout << std::endl;
+    if (failures) {
+        std::cerr << failures << " files failed." << std::endl;
+        return 1;
+    }
+    std::cout << "Self-test passed." << std::endl;
+    return 0;
+}
+
+// --- FUSE Glue ---
+#ifdef ACF_HAVE_FUSE
+const MountFs& ContextFs() {
+    return *static_cast<const MountFs*>(fuse_get_context()->private_data);
+}
+
+void* FuseInit(struct fuse_conn_info*, struct fuse_config* cfg) {
+    cfg->kernel_cache = 1; // Content never changes under a mount
+    return fuse_get_context()->private_data;
+}
+
+int FuseGetAttr(const char* path, struct stat* st, struct fuse_file_info*) {
+    return ContextFs().GetAttr(path, st);
+}
+
+int FuseReadDir(const char* path, void* buf, fuse_fill_dir_t filler, off_t, struct fuse_file_info*, enum fuse_readdir_flags) {
+    return ContextFs().ReadDir(path, [&](const char* name, const struct stat* st) {
+        filler(buf, name, st, 0, static_cast<enum fuse_fill_dir_flags>(0));
+    });
+}
+
+int FuseOpen(const char* path, struct fuse_file_info* fi) {
+    uint64_t handle = 0;
+    int err = ContextFs().Open(path, fi->flags, handle);
+    if (!err) {
+        fi->fh = handle;
+        fi->keep_cache = 1;
+    }
+    return err;
+}
+
+int FuseRead(const char*, char* buffer, size_t size, off_t offset, struct fuse_file_info* fi) {
+    return ContextFs().Read(fi->fh, buffer, size, offset);
+}
+
+int FuseRelease(const char*, struct fuse_file_info* fi) {
+    return ContextFs().Release(fi->fh);
+}
+
+int Mount(MountFs& fs, const std::string& archivePath, const std::string& mountPoint, const std::vector<std::string>& fuseArgs) {
+    struct fuse_operations ops = {};
+    ops.init = FuseInit;
+    ops.getattr = FuseGetAttr;
+    ops.readdir = FuseReadDir;
+    ops.open = FuseOpen;
+    ops.read = FuseRead;
+    ops.release = FuseRelease;
+
+    std::string fsname;
+    for (char c : archivePath) {
+        if (c == ',' || c == '\\') fsname += '\\';
+        fsname += c;
+    }
+    std::vector<std::string> args = { "acfmount", mountPoint, "-o", "ro,default_permissions,fsname=" + fsname + ",subtype=acf" };
+    args.insert(args.end(), fuseArgs.begin(), fuseArgs.end());
+    std::vector<char*> argv;
+    for (auto& arg : args) argv.push_back(arg.data());
+    return fuse_main(static_cast<int>(argv.size()), argv.data(), &ops, &fs);
+}
+#else
+int Mount(MountFs&, const std::string&, const std::string&, const std::vector<std::string>&) {
+    std::cerr << "Error: acfmount was built without libfuse3; only --self-test is available." << std::endl;
+    return 1;
+}
+#endif
+
+void PrintUsage() {
+    std::cout << "Usage: acfmount [options] <archive.acf> <mountpoint> [fuse options]" << std::endl;
+    std::cout << "       acfmount --self-test[=THREADS] [options] <archive.acf>" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --cache-mb=N                               : Decoded block cache shared by all open files (256)." << std::endl;
+    std::cout << "  --base=<previous.acf>                      : Base of a delta archive, if not next to it under its recorded name." << std::endl;
+    std::cout << "  --repo=<dir>                               : Chunk repository of a manifest, if moved from its recorded path." << std::endl;
+    std::cout << "  --record-profile=<file>                    : On exit, write the order files were first read in (for acfcli c --layout-profile)." << std::endl;
+    std::cout << "FUSE options (e.g. -f, -s, -o allow_other) are passed through; the mount is always read-only." << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    acf::ArchiveReaderOptions options;
+    size_t cacheMB = kDefaultCacheMB;
+    int selfTestThreads = 0;
+    std::string profilePath;
+    std::vector<std::string> args, fuseArgs;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            std::string name = arg.substr(0, arg.find('='));
+            std::string value = arg.find('=') != std::string::npos ? arg.substr(arg.find('=') + 1) : "";
+            if (name == "--cache-mb") cacheMB = std::stoull(value);
+            else if (name == "--base") options.basePath = value;
+            else if (name == "--repo") options.repositoryPath = value;
+            else if (name == "--record-profile") profilePath = value;
+            else if (name == "--self-test") selfTestThreads = value.empty() ? static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) : std::stoi(value);
+            else if (name == "--help" || name == "-h") { PrintUsage(); return 0; }
+            else if (arg == "-o" && i + 1 < argc) { fuseArgs.push_back(arg); fuseArgs.push_back(argv[++i]); }
+            else if (!arg.empty() && arg[0] == '-') fuseArgs.push_back(arg);
+            else args.push_back(arg);
+        }
+        if (args.size() != (selfTestThreads ? 1u : 2u)) {
+            PrintUsage();
+            return 1;
+        }
+        // Without -f, fuse_main() daemonizes and changes to "/", and the base
+        // and repository are only opened on the first read.
+        auto absolute = [](std::string& path) { if (!path.empty()) path = std::filesystem::absolute(path).string(); };
+        absolute(args[0]);
+        absolute(options.basePath);
+        absolute(options.repositoryPath);
+        absolute(profilePath);
+        if (cacheMB) options.cache = std::make_shared<acf::BlockCache>(cacheMB << 20);
+        options.recordAccess = !profilePath.empty();
+
+        MountFs fs(args[0], options);
+        int result;
+        if (selfTestThreads) {
+            acf::ArchiveReaderOptions referenceOptions = options;
+            referenceOptions.cache.reset();
+            referenceOptions.recordAccess = false;
+            acf::ArchiveReader reference(args[0], referenceOptions);
+            result = SelfTest(fs, reference, static_cast<unsigned>(selfTestThreads));
+        } else {
+            result = Mount(fs, args[0], args[1], fuseArgs);
+        }
+        if (!profilePath.empty()) fs.Vfs().Reader().SaveAccessProfile(profilePath);
+        return result;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,237 @@
+#include "acf.hh"
+#include "acfplatform.hh"
+#include "acfinternal.hh"
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <cctype>
+#include <numeric>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <tuple>
+
+namespace {
+
+constexpr size_t kSketchBytes = 64 << 10;  // MinHash is taken over the head of each file
+constexpr size_t kSketchSize = 16;
+constexpr double kMinSimilarity = 0.5;
+constexpr size_t kMaxClusterProbes = 64;   // Recent clusters of an extension compared against
+constexpr uint64_t kMinReadAheadBatch = 1 << 20;
+
+struct InputKey
+{
+    std::string ext;
+    std::string stem;
+    uint64_t size = 0;
+};
+
+std::string Lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+uint64_t Mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+using Sketch = std::vector<uint64_t>;
+
+// Minimum of kSketchSize independent hashes over all 8-byte shingles.
+Sketch ComputeSketch(const std::filesystem::path& p) {
+    Sketch sketch;
+    acf::platform::FileReader reader;
+    acf::platform::FileInfo info;
+    if (!reader.Open(p, info)) return sketch;
+    std::vector<uint8_t> head(std::min<uint64_t>(info.size, kSketchBytes));
+    head.resize(reader.Read(head.data(), head.size()));
+    reader.Close();
+    if (head.size() < 8) return sketch;
+
+    sketch.assign(kSketchSize, UINT64_MAX);
+    uint64_t shingle = 0;
+    for (size_t i = 0; i < head.size(); ++i) {
+        shingle = (shingle << 8) | head[i];
+        if (i < 7) continue;
+        uint64_t h = Mix(shingle);
+        for (size_t k = 0; k < kSketchSize; ++k) {
+            sketch[k] = std::min(sketch[k], Mix(h + k * 0x9E3779B97F4A7C15ull));
+        }
+    }
+    return sketch;
+}
+
+double Similarity(const Sketch& a, const Sketch& b) {
+    if (a.empty() || b.empty()) return 0.0;
+    size_t same = 0;
+    for (size_t k = 0; k < kSketchSize; ++k) same += a[k] == b[k];
+    return static_cast<double>(same) / kSketchSize;
+}
+
+} // namespace
+
+namespace acf::detail
+{
+  std::vector<OrderedInput> OrderInputs(const std::vector<std::filesystem::path>& files, FileOrder order)
+  {
+    std::vector<OrderedInput> result(files.size());
+    for (size_t i = 0; i < files.size(); ++i) result[i] = { i, i };
+    if (order == FileOrder::Path) return result;
+
+    std::vector<InputKey> keys(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        platform::FileInfo info;
+        platform::Stat(files[i], info);
+        keys[i] = { Lower(files[i].extension().string()), Lower(files[i].stem().string()), info.size };
+    }
+
+    // Group ids: files with the same extension and base name share one. With
+    // MinHash, files of one extension join the first recent cluster whose
+    // founder's sketch is similar enough, whatever their names.
+    std::vector<size_t> group(files.size());
+    if (order == FileOrder::MinHash) {
+        struct Cluster { size_t id; Sketch sketch; };
+        std::map<std::string, std::vector<Cluster>> clusters;
+        size_t nextId = 0;
+        for (size_t i = 0; i < files.size(); ++i) {
+            Sketch sketch = ComputeSketch(files[i]);
+            auto& candidates = clusters[keys[i].ext];
+            size_t found = SIZE_MAX;
+            size_t probes = std::min(candidates.size(), kMaxClusterProbes);
+            for (size_t c = candidates.size() - probes; c < candidates.size(); ++c) {
+                if (Similarity(sketch, candidates[c].sketch) >= kMinSimilarity) { found = candidates[c].id; break; }
+            }
+            if (found == SIZE_MAX) {
+                found = nextId++;
+                candidates.push_back({ found, std::move(sketch) });
+            }
+            group[i] = found;
+        }
+    } else {
+        std::map<std::pair<std::string, std::string>, size_t> ids;
+        for (size_t i = 0; i < files.size(); ++i) {
+            group[i] = ids.emplace(std::make_pair(keys[i].ext, keys[i].stem), ids.size()).first->second;
+        }
+    }
+
+    // Extension, then group (ordered by its base name), then size, largest
+    // first so a group's reference file is as big as allowed. Ties keep path order.
+    std::vector<std::string> groupStem(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (groupStem[group[i]].empty()) groupStem[group[i]] = keys[i].stem;
+    }
+    std::vector<size_t> indices(files.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::stable_sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+        const InputKey& ka = keys[a];
+        const InputKey& kb = keys[b];
+        if (ka.ext != kb.ext) return ka.ext < kb.ext;
+        if (group[a] != group[b]) {
+            const std::string& sa = groupStem[group[a]];
+            const std::string& sb = groupStem[group[b]];
+            return sa != sb ? sa < sb : group[a] < group[b];
+        }
+        return ka.size > kb.size;
+    });
+    for (size_t i = 0; i < indices.size(); ++i) result[i] = { indices[i], group[indices[i]] };
+    return result;
+  }
+
+  // --- Read-ahead ---
+  struct ReadAhead::State
+  {
+    std::vector<std::filesystem::path> files;
+    ReadOrder order;
+    uint64_t batchBytes;
+    std::mutex mutex;
+    std::condition_variable advanced;
+    std::atomic<size_t> position{0};
+    std::atomic<bool> stop{false};
+    std::thread thread;
+
+    void Run();
+  };
+
+  void ReadAhead::State::Run()
+  {
+    struct Item
+    {
+      platform::DiskLocation location;
+      size_t index;
+    };
+    std::vector<char> buffer(1 << 20);
+    platform::FileReader reader;
+    size_t previous = 0;
+    for (size_t begin = 0; begin < files.size() && !stop;) {
+        // At most two batches ahead: the next one is read once Create() has
+        // reached the one before it.
+        {
+            std::unique_lock lock(mutex);
+            advanced.wait(lock, [&] { return stop || position >= previous; });
+            if (stop) return;
+        }
+        std::vector<Item> batch;
+        uint64_t bytes = 0;
+        size_t end = begin;
+        for (; end < files.size() && bytes < batchBytes; ++end) {
+            platform::FileInfo info;
+            // Files larger than a batch are read sequentially by Create() anyway.
+            if (!platform::Stat(files[end], info) || info.size == 0 || info.size > batchBytes) continue;
+            Item item{ {}, end };
+            if (!platform::Locate(files[end], order == ReadOrder::Extent, item.location)) continue;
+            bytes += info.size;
+            batch.push_back(item);
+        }
+        std::sort(batch.begin(), batch.end(), [](const Item& a, const Item& b) {
+            return std::tie(a.location.physical, a.location.inode, a.index) <
+                   std::tie(b.location.physical, b.location.inode, b.index);
+        });
+        for (const Item& item : batch) {
+            if (stop) return;
+            if (position > item.index) continue; // Create() got there first
+            platform::FileInfo info;
+            if (!reader.Open(files[item.index], info)) continue;
+            while (!stop && reader.Read(buffer.data(), buffer.size()) > 0) {}
+            reader.Close();
+        }
+        previous = begin;
+        begin = end;
+    }
+  }
+
+  ReadAhead::ReadAhead(std::vector<std::filesystem::path> files, ReadOrder order, uint64_t windowBytes)
+      : m_State(std::make_unique<State>())
+  {
+    m_State->files = std::move(files);
+    m_State->order = order;
+    m_State->batchBytes = std::max<uint64_t>(windowBytes / 2, kMinReadAheadBatch);
+    m_State->thread = std::thread([state = m_State.get()] { state->Run(); });
+  }
+
+  ReadAhead::~ReadAhead()
+  {
+    {
+        std::lock_guard lock(m_State->mutex);
+        m_State->stop = true;
+    }
+    m_State->advanced.notify_all();
+    m_State->thread.join();
+  }
+
+  void ReadAhead::Advance(size_t position)
+  {
+    {
+        std::lock_guard lock(m_State->mutex);
+        m_State->position = position;
+    }
+    m_State->advanced.notify_all();
+  }
+
+} // namespace acf::detail
@@ -0,0 +1,674 @@
+#include "acfplatform.hh"
+#include "acf.hh"
+#include <string>
+#include <filesystem>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <ctime>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+
+// --- Utility Functions ---
+std::wstring StringToWString(const std::string& s) {
+    if (s.empty()) return std::wstring();
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), NULL, 0);
+    std::wstring r(len, 0);
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.length(), &r[0], len);
+    return r;
+}
+
+std::string WStringToString(const std::wstring& s) {
+    if (s.empty()) return std::string();
+    int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), (int)s.length(), NULL, 0, NULL, NULL);
+    std::string r(len, 0);
+    WideCharToMultiByte(CP_UTF8, 0, s.c_str(), (int)s.length(), &r[0], len, NULL, NULL);
+    return r;
+}
+
+namespace {
+
+// --- Date/Time Conversion ---
+uint32_t FileTimeToDosDateTime(const FILETIME& ft) {
+    WORD dosDate, dosTime;
+    // Do not convert to local time; Total Commander likely expects UTC.
+    FileTimeToDosDateTime(&ft, &dosDate, &dosTime);
+    return (static_cast<uint32_t>(dosDate) << 16) | dosTime;
+}
+
+FILETIME DosDateTimeToFileTime(uint32_t dosDateTime) {
+    FILETIME ft, lft;
+    DosDateTimeToFileTime(static_cast<WORD>(dosDateTime >> 16), static_cast<WORD>(dosDateTime & 0xFFFF), &lft);
+    LocalFileTimeToFileTime(&lft, &ft); // Convert to UTC
+    return ft;
+}
+
+} // namespace
+
+namespace acf::platform
+{
+  std::string ToInternalPath(const fs::path& p) {
+    return WStringToString(p.generic_wstring());
+  }
+
+  fs::path FromInternalPath(const std::string& s) {
+    return fs::path(StringToWString(s));
+  }
+
+  bool Stat(const fs::path& p, FileInfo& info) {
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if (!GetFileAttributesExW(p.c_str(), GetFileExInfoStandard, &fad)) {
+        info = FileInfo{};
+        return false;
+    }
+    ULARGE_INTEGER size;
+    size.LowPart = fad.nFileSizeLow;
+    size.HighPart = fad.nFileSizeHigh;
+    info.size = size.QuadPart;
+    info.dosDateTime = FileTimeToDosDateTime(fad.ftLastWriteTime);
+    info.attributes = static_cast<uint8_t>(fad.dwFileAttributes);
+    info.unixMode = 0;
+    info.directory = (fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    info.regular = !info.directory && !(fad.dwFileAttributes & FILE_ATTRIBUTE_DEVICE);
+    return true;
+  }
+
+  void ApplyFileInfo(const fs::path& p, uint32_t dosDateTime, uint8_t attributes, uint32_t /*unixMode*/, bool /*specialBits*/) {
+    FILETIME ft = DosDateTimeToFileTime(dosDateTime);
+    ULARGE_INTEGER uli;
+    uli.LowPart = ft.dwLowDateTime;
+    uli.HighPart = ft.dwHighDateTime;
+    auto ftime = fs::file_time_type(fs::file_time_type::duration(uli.QuadPart));
+    std::error_code ec;
+    fs::last_write_time(p, ftime, ec); // Ignore error
+    SetFileAttributesW(p.c_str(), attributes);
+  }
+
+  uint32_t CurrentDosDateTime() {
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    return FileTimeToDosDateTime(ft);
+  }
+
+  bool Locate(const fs::path& p, bool physical, DiskLocation& location) {
+    location = DiskLocation{};
+    HANDLE handle = CreateFileW(p.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    BY_HANDLE_FILE_INFORMATION fileInfo;
+    const bool ok = GetFileInformationByHandle(handle, &fileInfo) != 0;
+    if (ok) {
+        location.inode = (static_cast<uint64_t>(fileInfo.nFileIndexHigh) << 32) | fileInfo.nFileIndexLow;
+    }
+    if (ok && physical) {
+        STARTING_VCN_INPUT_BUFFER start{};
+        RETRIEVAL_POINTERS_BUFFER extents{};
+        DWORD returned = 0;
+        // One extent is enough; ERROR_MORE_DATA only says there are more.
+        if ((DeviceIoControl(handle, FSCTL_GET_RETRIEVAL_POINTERS, &start, sizeof(start), &extents, sizeof(extents), &returned, NULL) ||
+             GetLastError() == ERROR_MORE_DATA) &&
+            extents.ExtentCount > 0 && extents.Extents[0].Lcn.QuadPart >= 0) {
+            location.physical = static_cast<uint64_t>(extents.Extents[0].Lcn.QuadPart);
+        }
+    }
+    CloseHandle(handle);
+    return ok;
+  }
+
+  FileReader::FileReader() {}
+  FileReader::~FileReader() {}
+
+  bool FileReader::Open(const fs::path& p, FileInfo& info) {
+    Close();
+    Stat(p, info);
+    m_File.open(p, std::ios::binary);
+    return static_cast<bool>(m_File);
+  }
+
+  size_t FileReader::Read(void* buffer, size_t size) {
+    m_File.read(static_cast<char*>(buffer), size);
+    return static_cast<size_t>(m_File.gcount());
+  }
+
+  bool FileReader::Rewind() {
+    m_File.clear();
+    m_File.seekg(0);
+    return static_cast<bool>(m_File);
+  }
+
+  void FileReader::Close() {
+    if (m_File.is_open()) m_File.close();
+    m_File.clear();
+  }
+
+  FileWriter::FileWriter() {}
+  FileWriter::~FileWriter() {}
+
+  bool FileWriter::Open(const fs::path& p, uint64_t /*expectedSize*/) {
+    Close();
+    m_File.open(p, std::ios::binary | std::ios::trunc);
+    return static_cast<bool>(m_File);
+  }
+
+  bool FileWriter::Write(const void* data, size_t size) {
+    m_File.write(static_cast<const char*>(data), size);
+    return static_cast<bool>(m_File);
+  }
+
+  bool FileWriter::Close() {
+    bool ok = true;
+    if (m_File.is_open()) {
+        m_File.close();
+        ok = static_cast<bool>(m_File);
+    }
+    m_File.clear();
+    return ok;
+  }
+
+  RandomAccessFile::RandomAccessFile() {}
+
+  RandomAccessFile::~RandomAccessFile() {
+    Close();
+  }
+
+  bool RandomAccessFile::Open(const fs::path& p) {
+    Close();
+    HANDLE h = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(h, &size)) {
+        CloseHandle(h);
+        return false;
+    }
+    m_Handle = h;
+    m_Size = static_cast<uint64_t>(size.QuadPart);
+    return true;
+  }
+
+  bool RandomAccessFile::ReadAt(void* buffer, size_t size, uint64_t offset) const {
+    char* out = static_cast<char*>(buffer);
+    while (size > 0) {
+        OVERLAPPED ov = {};
+        ov.Offset = static_cast<DWORD>(offset);
+        ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD got = 0;
+        if (!ReadFile(m_Handle, out, chunk, &got, &ov) || got == 0) return false;
+        out += got;
+        offset += got;
+        size -= got;
+    }
+    return true;
+  }
+
+  bool RandomAccessFile::Map() {
+    if (m_Data) return true;
+    if (!m_Handle || m_Size == 0 || m_Size > SIZE_MAX) return false;
+    HANDLE mapping = CreateFileMappingW(m_Handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_Mapping = mapping;
+    m_Data = static_cast<const uint8_t*>(view);
+    return true;
+  }
+
+  void RandomAccessFile::Close() {
+    if (m_Data) {
+        UnmapViewOfFile(m_Data);
+        CloseHandle(m_Mapping);
+        m_Data = nullptr;
+        m_Mapping = nullptr;
+    }
+    if (m_Handle) {
+        CloseHandle(m_Handle);
+        m_Handle = nullptr;
+    }
+    m_Size = 0;
+  }
+
+  FileLock::FileLock() {}
+
+  FileLock::~FileLock() {
+    Unlock();
+  }
+
+  bool FileLock::TryLock(const fs::path& p) {
+    Unlock();
+    HANDLE h = CreateFileW(p.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    OVERLAPPED overlapped = {};
+    if (!LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped)) {
+        CloseHandle(h);
+        return false;
+    }
+    m_Handle = h;
+    return true;
+  }
+
+  void FileLock::Unlock() {
+    if (m_Handle) {
+        CloseHandle(m_Handle); // Releases the lock
+        m_Handle = nullptr;
+    }
+  }
+
+} // namespace acf::platform
+
+#else // POSIX
+
+// --- Utility Functions ---
+// wchar_t is UTF-32 on POSIX systems, so the conversion is done by hand.
+std::wstring StringToWString(const std::string& s) {
+    std::wstring r;
+    r.reserve(s.size());
+    for (size_t i = 0; i < s.size();) {
+        uint8_t c = static_cast<uint8_t>(s[i]);
+        uint32_t cp;
+        size_t extra;
+        if (c < 0x80)      { cp = c;        extra = 0; }
+        else if (c < 0xE0) { cp = c & 0x1F; extra = 1; }
+        else if (c < 0xF0) { cp = c & 0x0F; extra = 2; }
+        else               { cp = c & 0x07; extra = 3; }
+        if (i + extra >= s.size()) { // Truncated sequence
+            r += static_cast<wchar_t>(0xFFFD);
+            break;
+        }
+        for (size_t k = 1; k <= extra; ++k) {
+            cp = (cp << 6) | (static_cast<uint8_t>(s[i + k]) & 0x3F);
+        }
+        r += static_cast<wchar_t>(cp);
+        i += extra + 1;
+    }
+    return r;
+}
+
+std::string WStringToString(const std::wstring& s) {
+    std::string r;
+    r.reserve(s.size());
+    for (wchar_t wc : s) {
+        uint32_t cp = static_cast<uint32_t>(wc);
+        if (cp < 0x80) {
+            r += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            r += static_cast<char>(0xC0 | (cp >> 6));
+            r += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            r += static_cast<char>(0xE0 | (cp >> 12));
+            r += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            r += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            r += static_cast<char>(0xF0 | (cp >> 18));
+            r += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            r += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            r += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+    return r;
+}
+
+namespace {
+
+// --- Date/Time Conversion ---
+// DOS timestamps carry no zone; like the Win32 side they are read back as local time.
+uint32_t TimeToDosDateTime(time_t t) {
+    struct tm lt;
+    if (!localtime_r(&t, &lt) || lt.tm_year < 80) {
+        return (1u << 21) | (1u << 16); // 1980-01-01 00:00:00
+    }
+    uint32_t dosDate = ((lt.tm_year - 80) << 9) | ((lt.tm_mon + 1) << 5) | lt.tm_mday;
+    uint32_t dosTime = (lt.tm_hour << 11) | (lt.tm_min << 5) | (lt.tm_sec / 2);
+    return (dosDate << 16) | dosTime;
+}
+
+time_t DosDateTimeToTime(uint32_t dosDateTime) {
+    uint16_t dosDate = static_cast<uint16_t>(dosDateTime >> 16);
+    uint16_t dosTime = static_cast<uint16_t>(dosDateTime & 0xFFFF);
+    struct tm lt{};
+    lt.tm_year = ((dosDate >> 9) & 0x7F) + 80;
+    lt.tm_mon = ((dosDate >> 5) & 0x0F) - 1;
+    lt.tm_mday = dosDate & 0x1F;
+    lt.tm_hour = (dosTime >> 11) & 0x1F;
+    lt.tm_min = (dosTime >> 5) & 0x3F;
+    lt.tm_sec = (dosTime & 0x1F) * 2;
+    lt.tm_isdst = -1;
+    return mktime(&lt);
+}
+
+// Maps POSIX mode bits onto the Win32 attribute byte so listings look the same on both platforms.
+uint8_t ModeToAttributes(const fs::path& p, uint32_t mode) {
+    uint8_t attr = S_ISDIR(mode) ? acf::ATTR_DIRECTORY : acf::ATTR_ARCHIVE;
+    if (!(mode & S_IWUSR)) attr |= acf::ATTR_READONLY;
+    std::string name = p.filename().string();
+    if (name.size() > 1 && name[0] == '.' && name != "..") attr |= acf::ATTR_HIDDEN;
+    return attr;
+}
+
+void FillInfo(const fs::path& p, uint64_t size, time_t mtime, uint32_t mode, acf::platform::FileInfo& info) {
+    info.size = size;
+    info.dosDateTime = TimeToDosDateTime(mtime);
+    info.unixMode = mode;
+    info.attributes = ModeToAttributes(p, mode);
+    info.directory = S_ISDIR(mode);
+    info.regular = S_ISREG(mode);
+}
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+bool StatAt(int dirFd, const char* name, int flags, const fs::path& p, acf::platform::FileInfo& info) {
+    struct statx stx;
+    if (statx(dirFd, name, flags, STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME, &stx) != 0) {
+        return false;
+    }
+    FillInfo(p, stx.stx_size, stx.stx_mtime.tv_sec, stx.stx_mode, info);
+    return true;
+}
+#endif
+
+} // namespace
+
+namespace acf::platform
+{
+  std::string ToInternalPath(const fs::path& p) {
+    return p.generic_string();
+  }
+
+  fs::path FromInternalPath(const std::string& s) {
+    return fs::path(s);
+  }
+
+  bool Stat(const fs::path& p, FileInfo& info) {
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+    if (StatAt(AT_FDCWD, p.c_str(), 0, p, info)) return true;
+#else
+    struct stat st;
+    if (::stat(p.c_str(), &st) == 0) {
+        FillInfo(p, st.st_size, st.st_mtime, st.st_mode, info);
+        return true;
+    }
+#endif
+    info = FileInfo{};
+    return false;
+  }
+
+  void ApplyFileInfo(const fs::path& p, uint32_t dosDateTime, uint8_t attributes, uint32_t unixMode, bool specialBits) {
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = DosDateTimeToTime(dosDateTime);
+    times[1].tv_nsec = 0;
+    utimensat(AT_FDCWD, p.c_str(), times, 0); // Ignore error
+
+    if (unixMode != 0) {
+        // Like tar without -p: archive data must not hand out setuid/setgid unasked.
+        chmod(p.c_str(), unixMode & (specialBits ? 07777 : 0777));
+    } else if (attributes & acf::ATTR_READONLY) {
+        // Archive written on Windows: only the read-only bit can be honoured.
+        struct stat st;
+        if (::stat(p.c_str(), &st) == 0) {
+            chmod(p.c_str(), st.st_mode & 07777 & ~(S_IWUSR | S_IWGRP | S_IWOTH));
+        }
+    }
+  }
+
+  uint32_t CurrentDosDateTime() {
+    return TimeToDosDateTime(time(nullptr));
+  }
+
+  bool Locate(const fs::path& p, bool physical, DiskLocation& location) {
+    location = DiskLocation{};
+    const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) return false;
+    struct stat st;
+    const bool ok = fstat(fd, &st) == 0;
+    if (ok) location.inode = static_cast<uint64_t>(st.st_ino);
+#if defined(__linux__) && defined(FS_IOC_FIEMAP)
+    if (ok && physical) {
+        alignas(struct fiemap) uint8_t request[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] = {};
+        struct fiemap* map = reinterpret_cast<struct fiemap*>(request);
+        map->fm_length = FIEMAP_MAX_OFFSET;
+        map->fm_extent_count = 1;
+        if (ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents > 0 &&
+            !(map->fm_extents[0].fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE))) {
+            location.physical = map->fm_extents[0].fe_physical;
+        }
+    }
+#else
+    (void)physical;
+#endif
+    ::close(fd);
+    return ok;
+  }
+
+  FileReader::FileReader() {}
+
+  FileReader::~FileReader() {
+    Close();
+    if (m_DirFd >= 0) ::close(m_DirFd);
+  }
+
+  bool FileReader::Open(const fs::path& p, FileInfo& info) {
+    Close();
+    info = FileInfo{};
+
+    fs::path dir = p.parent_path();
+    if (dir.empty()) dir = ".";
+    if (m_DirFd < 0 || dir != m_DirPath) {
+        if (m_DirFd >= 0) ::close(m_DirFd);
+        m_DirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        m_DirPath = dir;
+        if (m_DirFd < 0) return false;
+    }
+
+    // O_NONBLOCK keeps a FIFO from blocking the open; regular files ignore it.
+    m_Fd = ::openat(m_DirFd, p.filename().c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (m_Fd < 0) return false;
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+    StatAt(m_Fd, "", AT_EMPTY_PATH, p, info);
+#else
+    struct stat st;
+    if (::fstat(m_Fd, &st) == 0) {
+        FillInfo(p, st.st_size, st.st_mtime, st.st_mode, info);
+    }
+#endif
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(m_Fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+  }
+
+  size_t FileReader::Read(void* buffer, size_t size) {
+    size_t total = 0;
+    char* out = static_cast<char*>(buffer);
+    while (total < size) {
+        ssize_t n = ::read(m_Fd, out + total, size - total);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        total += static_cast<size_t>(n);
+    }
+    return total;
+  }
+
+  bool FileReader::Rewind() {
+    return ::lseek(m_Fd, 0, SEEK_SET) == 0;
+  }
+
+  void FileReader::Close() {
+    if (m_Fd >= 0) {
+        ::close(m_Fd);
+        m_Fd = -1;
+    }
+  }
+
+  FileWriter::FileWriter() {}
+
+  FileWriter::~FileWriter() {
+    Close();
+  }
+
+  bool FileWriter::Open(const fs::path& p, uint64_t expectedSize) {
+    Close();
+    m_Fd = ::open(p.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (m_Fd < 0) return false;
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    if (expectedSize > 0) {
+        fallocate(m_Fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(expectedSize)); // Best effort
+    }
+#else
+    (void)expectedSize;
+#endif
+    return true;
+  }
+
+  bool FileWriter::Write(const void* data, size_t size) {
+    const char* in = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(m_Fd, in, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        in += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  bool FileWriter::Close() {
+    bool ok = true;
+    if (m_Fd >= 0) {
+        ok = ::close(m_Fd) == 0;
+        m_Fd = -1;
+    }
+    return ok;
+  }
+
+  RandomAccessFile::RandomAccessFile() {}
+
+  RandomAccessFile::~RandomAccessFile() {
+    Close();
+  }
+
+  bool RandomAccessFile::Open(const fs::path& p) {
+    Close();
+    m_Fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_Fd < 0) return false;
+    struct stat st;
+    if (::fstat(m_Fd, &st) != 0) {
+        Close();
+        return false;
+    }
+    m_Size = static_cast<uint64_t>(st.st_size);
+#ifdef POSIX_FADV_RANDOM
+    posix_fadvise(m_Fd, 0, 0, POSIX_FADV_RANDOM);
+#endif
+    return true;
+  }
+
+  bool RandomAccessFile::ReadAt(void* buffer, size_t size, uint64_t offset) const {
+    char* out = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = ::pread(m_Fd, out, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        out += n;
+        offset += static_cast<uint64_t>(n);
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  bool RandomAccessFile::Map() {
+    if (m_Data) return true;
+    if (m_Fd < 0 || m_Size == 0 || m_Size > SIZE_MAX) return false;
+    const size_t size = static_cast<size_t>(m_Size);
+    void* p = MAP_FAILED;
+    // Archives of 2 MiB or more are mapped at a 2 MiB boundary, so entries
+    // stored at 2 MiB aligned offsets are aligned in memory as well and can
+    // be backed by huge pages where the kernel supports that for files.
+    constexpr size_t kLargeAlignment = 2 << 20;
+    if (size >= kLargeAlignment) {
+        void* area = ::mmap(nullptr, size + kLargeAlignment, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (area != MAP_FAILED) {
+            const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            char* start = static_cast<char*>(area);
+            char* aligned = start + (kLargeAlignment - reinterpret_cast<uintptr_t>(start) % kLargeAlignment) % kLargeAlignment;
+            char* end = aligned + (size + page - 1) / page * page;
+            p = ::mmap(aligned, size, PROT_READ, MAP_SHARED | MAP_FIXED, m_Fd, 0);
+            if (p == MAP_FAILED) {
+                ::munmap(area, size + kLargeAlignment);
+            } else {
+                if (aligned > start) ::munmap(start, aligned - start);
+                if (end < start + size + kLargeAlignment) ::munmap(end, start + size + kLargeAlignment - end);
+            }
+        }
+    }
+    if (p == MAP_FAILED) p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, m_Fd, 0);
+    if (p == MAP_FAILED) return false;
+    m_Data = static_cast<const uint8_t*>(p);
+    return true;
+  }
+
+  void RandomAccessFile::Close() {
+    if (m_Data) {
+        ::munmap(const_cast<uint8_t*>(m_Data), static_cast<size_t>(m_Size));
+        m_Data = nullptr;
+    }
+    if (m_Fd >= 0) {
+        ::close(m_Fd);
+        m_Fd = -1;
+    }
+    m_Size = 0;
+  }
+
+  FileLock::FileLock() {}
+
+  FileLock::~FileLock() {
+    Unlock();
+  }
+
+  bool FileLock::TryLock(const fs::path& p) {
+    Unlock();
+    const int fd = ::open(p.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0) return false;
+    // flock locks belong to the open file description, so a second lock
+    // from the same process conflicts too, unlike fcntl record locks.
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd);
+        return false;
+    }
+    m_Fd = fd;
+    return true;
+  }
+
+  void FileLock::Unlock() {
+    if (m_Fd >= 0) {
+        ::close(m_Fd); // Releases the lock
+        m_Fd = -1;
+    }
+  }
+
+} // namespace acf::platform
+
+#endif
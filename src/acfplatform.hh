@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <filesystem>
+#include <fstream>
+
+// Platform layer for libacf. Everything that touches the host filesystem API
+// (metadata, timestamps, attributes, native file handles) lives behind this
+// interface so that acf.cc stays platform neutral.
+namespace acf::platform
+{
+  // Metadata of a file or directory on the host, already mapped to the
+  // representation stored in ACFEntryData.
+  struct FileInfo
+  {
+    uint64_t size = 0;
+    uint32_t dosDateTime = 0;
+    uint8_t attributes = 0;
+    uint32_t unixMode = 0;
+    bool directory = false;
+    bool regular = false; // Not a directory, device, FIFO or socket
+  };
+
+  // Converts a host path to the internal archive form: UTF-8, '/' separated.
+  std::string ToInternalPath(const std::filesystem::path& p);
+  // Converts an internal archive path back to a host path.
+  std::filesystem::path FromInternalPath(const std::string& s);
+
+  bool Stat(const std::filesystem::path& p, FileInfo& info);
+  // Applies stored timestamp and attributes/mode to an extracted file or directory.
+  // The setuid, setgid and sticky bits of unixMode are only set with specialBits.
+  void ApplyFileInfo(const std::filesystem::path& p, uint32_t dosDateTime, uint8_t attributes, uint32_t unixMode,
+                     bool specialBits = false);
+  uint32_t CurrentDosDateTime();
+
+  // Where the data of a file lies on its volume, for reading many files in
+  // disk order: the inode number (file index on Windows) and, if asked for
+  // and known, the byte offset of the first physical extent (FIEMAP on
+  // Linux, the first cluster on Windows).
+  struct DiskLocation
+  {
+    uint64_t inode = 0;
+    uint64_t physical = UINT64_MAX;
+  };
+  bool Locate(const std::filesystem::path& p, bool physical, DiskLocation& location);
+
+  // Sequential reader for archive inputs. On POSIX consecutive opens from the
+  // same directory reuse one directory descriptor (openat), metadata comes from
+  // statx on the open descriptor and the kernel is told the access is sequential.
+  class FileReader
+  {
+  private:
+#ifdef _WIN32
+    std::ifstream m_File;
+#else
+    int m_Fd = -1;
+    int m_DirFd = -1;
+    std::filesystem::path m_DirPath;
+#endif
+  public:
+    FileReader();
+    ~FileReader();
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    bool Open(const std::filesystem::path& p, FileInfo& info);
+    size_t Read(void* buffer, size_t size);
+    bool Rewind();
+    void Close();
+  };
+
+  // Writer for extracted files. The expected size is preallocated up front
+  // (fallocate on Linux) so the filesystem can lay the file out contiguously.
+  class FileWriter
+  {
+  private:
+#ifdef _WIN32
+    std::ofstream m_File;
+#else
+    int m_Fd = -1;
+#endif
+  public:
+    FileWriter();
+    ~FileWriter();
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    bool Open(const std::filesystem::path& p, uint64_t expectedSize);
+    bool Write(const void* data, size_t size);
+    // False if the data could not be flushed.
+    bool Close();
+  };
+
+  // Read-only file for positional reads (pread on POSIX, ReadFile with an
+  // explicit offset on Windows). ReadAt() keeps no file position, so one
+  // open file can serve any number of threads at once. Map() additionally
+  // maps the whole file read-only for callers that want views, not copies.
+  class RandomAccessFile
+  {
+  private:
+#ifdef _WIN32
+    void* m_Handle = nullptr;
+    void* m_Mapping = nullptr;
+#else
+    int m_Fd = -1;
+#endif
+    uint64_t m_Size = 0;
+    const uint8_t* m_Data = nullptr;
+  public:
+    RandomAccessFile();
+    ~RandomAccessFile();
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+    bool Open(const std::filesystem::path& p);
+    // Reads exactly size bytes at offset; false on error or end of file.
+    bool ReadAt(void* buffer, size_t size, uint64_t offset) const;
+    uint64_t Size() const { return m_Size; }
+    // Maps the open file; false if that is not possible (e.g. empty file).
+    bool Map();
+    // Start of the mapping, nullptr unless mapped.
+    const uint8_t* Data() const { return m_Data; }
+    void Close();
+  };
+
+  // Exclusive advisory lock on a lock file, created if missing (flock on
+  // POSIX, LockFileEx on Windows). Held until Unlock() or destruction;
+  // another holder, in this process or another, makes TryLock() fail.
+  class FileLock
+  {
+  private:
+#ifdef _WIN32
+    void* m_Handle = nullptr;
+#else
+    int m_Fd = -1;
+#endif
+  public:
+    FileLock();
+    ~FileLock();
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    bool TryLock(const std::filesystem::path& p);
+    void Unlock();
+  };
+
+} // namespace acf::platform
@@ -0,0 +1,785 @@
+#include "acf.hh"
+#include "acfplatform.hh"
+#include "acfinternal.hh"
+#include "acffilter.hh"
+#include "acfrepo.hh"
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+namespace {
+
+constexpr size_t kReadChunk = 1 << 20; // Compressed bytes per positional read
+
+// Tells the archives of all readers apart in a shared block cache.
+std::atomic<uint64_t> g_NextReaderId{1};
+
+struct ZSTD_DCtx_Deleter { void operator()(ZSTD_DCtx* ptr) const { ZSTD_freeDCtx(ptr); } };
+using ZSTD_DCtx_Ptr = std::unique_ptr<ZSTD_DCtx, ZSTD_DCtx_Deleter>;
+
+// Decompression context of the calling thread, shared by all readers.
+ZSTD_DCtx* ThreadDCtx() {
+    thread_local ZSTD_DCtx_Ptr dctx(ZSTD_createDCtx());
+    if (!dctx) throw std::runtime_error("ZSTD_createDCtx() error");
+    return dctx.get();
+}
+
+// Bytes a read of the entry yields: stored .zst inputs come out as stored.
+uint64_t ContentSize(const acf::ACFEntryData& entry) {
+    return entry.method == acf::CompressionMethod::ZstdPassthrough ? entry.compressedSize : entry.originalSize;
+}
+
+uint64_t BlockCount(uint64_t size) {
+    return (size + acf::BlockCache::kBlockSize - 1) / acf::BlockCache::kBlockSize;
+}
+
+} // namespace
+
+namespace acf
+{
+  class ArchiveReader::Impl
+  {
+  public:
+    Impl(const std::string& archivePath, const ArchiveReaderOptions& readerOptions);
+
+    // Content of entries[index], through the block cache when there is one.
+    std::vector<uint8_t> Content(size_t index) const;
+    std::vector<uint8_t> ReadEntry(const ACFEntryData& entry, const std::string& path) const;
+    // Content of a file into out, which holds ContentSize(entry) bytes. A
+    // prefix the caller already has is used instead of looking it up.
+    void ReadEntryTo(const ACFEntryData& entry, const std::string& path, uint8_t* out,
+                     const std::span<const uint8_t>* knownPrefix = nullptr) const;
+
+    std::string path;
+    ArchiveReaderOptions options;
+    const uint64_t id = g_NextReaderId++;
+    platform::RandomAccessFile file;
+    ACFHeader header;
+    std::vector<std::pair<ACFEntryData, std::string>> entries;
+    std::unordered_map<std::string, size_t> byPath;
+    std::unordered_map<uint64_t, size_t> byOffset; // File entries by dataOffset, for prefix lookups
+
+    // Index of the entry stored under path, recorded as accessed; throws if there is none.
+    size_t Lookup(const std::string& path) const;
+
+    // First-touch order of files, with ArchiveReaderOptions::recordAccess
+    std::unique_ptr<std::atomic<bool>[]> touched;
+    mutable std::mutex accessMutex;
+    mutable std::vector<size_t> accessOrder;
+
+    // Content that primes the window of a patched or grouped entry; false if none does.
+    bool Prefix(const ACFEntryData& entry, const std::string& path, std::vector<uint8_t>& prefix) const;
+    const ArchiveReader& Base() const;
+    detail::ChunkRepository& Repository() const;
+
+  private:
+    // Decodes a zstd entry into out; an empty prefix means none.
+    void Decode(const ACFEntryData& entry, const std::string& path,
+                std::span<const uint8_t> prefix, uint8_t* out) const;
+    std::vector<uint8_t> ReadChunks(const ACFEntryData& entry, const std::string& path) const;
+
+    // Records after the header, kept from construction.
+    ACFBaseRecord m_BaseRecord{};
+    std::string m_BaseName;
+    std::string m_RepositoryRecord;
+
+    // Opened on first use; call_once makes that safe from any thread.
+    mutable std::once_flag m_BaseOnce;
+    mutable std::unique_ptr<ArchiveReader> m_Base;
+    mutable std::once_flag m_RepositoryOnce;
+    mutable std::shared_ptr<detail::ChunkRepository> m_Repository;
+  };
+
+  ArchiveReader::Impl::Impl(const std::string& archivePath, const ArchiveReaderOptions& readerOptions)
+      : path(archivePath), options(readerOptions)
+  {
+    if (!file.Open(archivePath)) {
+        throw std::runtime_error("Could not open archive file: " + archivePath);
+    }
+    if (options.map) file.Map();
+    if (!file.ReadAt(&header, sizeof(header), 0) || header.magic != ACF_MAGIC) {
+        throw std::runtime_error("Not a valid ACF archive: " + archivePath);
+    }
+    uint64_t centralDirSize = file.Size() - std::min(header.centralDirOffset, file.Size());
+    if ((header.flags & ACF_FLAG_FRONT_INDEX) &&
+        (header.centralDirOffset < sizeof(ACFHeader) + sizeof(uint64_t) ||
+         !file.ReadAt(&centralDirSize, sizeof(centralDirSize), header.centralDirOffset - sizeof(uint64_t)))) {
+        throw std::runtime_error("Central directory size missing. Archive is likely corrupted.");
+    }
+    if (header.centralDirOffset > file.Size() || centralDirSize > file.Size() - header.centralDirOffset) {
+        throw std::runtime_error("Central directory offset out of range. Archive is likely corrupted.");
+    }
+
+    std::vector<char> centralDir(centralDirSize);
+    if (!file.ReadAt(centralDir.data(), centralDir.size(), header.centralDirOffset) ||
+        detail::Crc32Update(0, centralDir.data(), centralDir.size()) != header.centralDirCRC32) {
+        throw std::runtime_error("Central directory CRC32 mismatch. Archive is likely corrupted.");
+    }
+    entries = detail::ParseCentralDirectory(centralDir.data(), centralDir.size(), header);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        byPath.emplace(entries[i].second, i);
+        // Only zstd entries prime others; an empty entry of another kind may share their offset.
+        if (entries[i].first.type == EntryType::File && entries[i].first.method == CompressionMethod::Zstd) {
+            byOffset.emplace(entries[i].first.dataOffset, i);
+        }
+    }
+
+    if (options.recordAccess) touched = std::make_unique<std::atomic<bool>[]>(entries.size());
+
+    if (header.flags & ACF_FLAG_BASE) {
+        file.ReadAt(&m_BaseRecord, sizeof(m_BaseRecord), sizeof(ACFHeader));
+        m_BaseName.resize(m_BaseRecord.nameLength);
+        file.ReadAt(m_BaseName.data(), m_BaseName.size(), sizeof(ACFHeader) + sizeof(ACFBaseRecord));
+    } else if (header.flags & ACF_FLAG_REPOSITORY) {
+        ACFRepositoryRecord record{};
+        file.ReadAt(&record, sizeof(record), sizeof(ACFHeader));
+        m_RepositoryRecord.resize(record.pathLength);
+        file.ReadAt(m_RepositoryRecord.data(), m_RepositoryRecord.size(), sizeof(ACFHeader) + sizeof(ACFRepositoryRecord));
+    }
+  }
+
+  size_t ArchiveReader::Impl::Lookup(const std::string& entryPath) const
+  {
+    auto it = byPath.find(detail::NormalizeInternalPath(entryPath));
+    if (it == byPath.end()) {
+        throw std::runtime_error("File not found in archive: " + entryPath);
+    }
+    if (touched && !touched[it->second].exchange(true, std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(accessMutex);
+        accessOrder.push_back(it->second);
+    }
+    return it->second;
+  }
+
+  const ArchiveReader& ArchiveReader::Impl::Base() const
+  {
+    std::call_once(m_BaseOnce, [this] {
+        if (!(header.flags & ACF_FLAG_BASE)) {
+            throw std::runtime_error("Archive has patched entries but no base record: " + path);
+        }
+        std::string basePath = detail::ResolveBaseArchive(m_BaseRecord, m_BaseName, path, options.basePath);
+        ArchiveReaderOptions baseOptions;
+        baseOptions.cache = options.cache;
+        m_Base = std::make_unique<ArchiveReader>(basePath, baseOptions);
+    });
+    return *m_Base;
+  }
+
+  detail::ChunkRepository& ArchiveReader::Impl::Repository() const
+  {
+    std::call_once(m_RepositoryOnce, [this] {
+        std::string repositoryPath = options.repositoryPath;
+        if (repositoryPath.empty()) {
+            if (!(header.flags & ACF_FLAG_REPOSITORY)) {
+                throw std::runtime_error("Archive has chunk entries but no repository record: " + path);
+            }
+            repositoryPath = detail::RecordedRepositoryPath(m_RepositoryRecord, path);
+        }
+        m_Repository = detail::ChunkRepository::Open(repositoryPath, false, false);
+    });
+    return *m_Repository;
+  }
+
+  std::vector<uint8_t> ArchiveReader::Impl::Content(size_t index) const
+  {
+    const auto& [entry, entryPath] = entries[index];
+    if (!options.cache || entry.type != EntryType::File) {
+        return ReadEntry(entry, entryPath);
+    }
+
+    const uint64_t size = ContentSize(entry);
+    const uint64_t blocks = BlockCount(size);
+    std::vector<uint8_t> data;
+    data.reserve(size);
+    for (uint64_t b = 0; b < blocks; ++b) {
+        auto block = options.cache->Find(id, index, b);
+        if (!block) break;
+        data.insert(data.end(), block->begin(), block->end());
+    }
+    if (data.size() == size) return data;
+
+    data = ReadEntry(entry, entryPath);
+    for (uint64_t b = 0; b < blocks; ++b) {
+        auto first = data.begin() + b * BlockCache::kBlockSize;
+        auto last = b + 1 < blocks ? first + BlockCache::kBlockSize : data.end();
+        options.cache->Insert(id, index, b, std::make_shared<const std::vector<uint8_t>>(first, last));
+    }
+    return data;
+  }
+
+  std::vector<uint8_t> ArchiveReader::Impl::ReadEntry(const ACFEntryData& entry, const std::string& entryPath) const
+  {
+    if (entry.type != EntryType::File) {
+        throw std::runtime_error("Cannot extract data from a directory entry: " + entryPath);
+    }
+    if (entry.method == CompressionMethod::ChunkRef) {
+        return ReadChunks(entry, entryPath);
+    }
+    std::vector<uint8_t> data(ContentSize(entry));
+    ReadEntryTo(entry, entryPath, data.data());
+    return data;
+  }
+
+  void ArchiveReader::Impl::ReadEntryTo(const ACFEntryData& entry, const std::string& entryPath, uint8_t* out,
+                                        const std::span<const uint8_t>* knownPrefix) const
+  {
+    if (entry.method == CompressionMethod::ChunkRef) {
+        std::vector<uint8_t> data = ReadChunks(entry, entryPath);
+        memcpy(out, data.data(), data.size());
+        return;
+    }
+    if (entry.method == CompressionMethod::Uncompressed) {
+        if (!file.ReadAt(out, entry.originalSize, entry.dataOffset)) {
+            throw std::runtime_error("Could not read data of file: " + entryPath);
+        }
+        if (detail::Crc32Update(0, out, entry.originalSize) != entry.crc32) {
+            throw std::runtime_error("CRC32 mismatch for file: " + entryPath);
+        }
+        return;
+    }
+
+    if (knownPrefix) {
+        Decode(entry, entryPath, *knownPrefix, out);
+        return;
+    }
+    std::vector<uint8_t> prefix;
+    Prefix(entry, entryPath, prefix);
+    Decode(entry, entryPath, prefix, out);
+  }
+
+  bool ArchiveReader::Impl::Prefix(const ACFEntryData& entry, const std::string& entryPath, std::vector<uint8_t>& prefix) const
+  {
+    if (entry.method == CompressionMethod::ZstdPatch) {
+        prefix = Base().Read(entryPath);
+        return true;
+    }
+    if (entry.prefixOffset) {
+        auto it = byOffset.find(entry.prefixOffset);
+        if (it == byOffset.end() || entries[it->second].first.prefixOffset ||
+            entries[it->second].first.method != CompressionMethod::Zstd) {
+            throw std::runtime_error("Prefix entry missing for file: " + entryPath);
+        }
+        prefix = Content(it->second);
+        return true;
+    }
+    return false;
+  }
+
+  void ArchiveReader::Impl::Decode(const ACFEntryData& entry, const std::string& entryPath,
+                                   std::span<const uint8_t> prefix, uint8_t* out) const
+  {
+    ZSTD_DCtx* dctx = ThreadDCtx();
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
+    ZSTD_DCtx_setParameter(dctx, ZSTD_d_windowLogMax, entry.windowLog ? entry.windowLog : detail::kDefaultWindowLogMax);
+    if (!prefix.empty()) ZSTD_DCtx_refPrefix(dctx, prefix.data(), prefix.size());
+
+    // Passthrough entries are read straight into out and decoded from there,
+    // only to check the CRC of their content. Filtered entries are decoded
+    // into a scratch buffer first and unfiltered into out.
+    const bool passthrough = entry.method == CompressionMethod::ZstdPassthrough;
+    const bool filtered = !passthrough && entry.filter != FilterType::None;
+    if (passthrough && !file.ReadAt(out, entry.compressedSize, entry.dataOffset)) {
+        throw std::runtime_error("Could not read data of file: " + entryPath);
+    }
+    std::vector<uint8_t> scratch(passthrough ? ZSTD_DStreamOutSize() : filtered ? entry.originalSize : 0);
+    uint8_t* decoded = passthrough || filtered ? scratch.data() : out;
+    std::vector<char> in;
+    ZSTD_outBuffer output = { decoded, passthrough ? scratch.size() : entry.originalSize, 0 };
+    uint64_t decodedSize = 0;
+    uint32_t crc = 0;
+
+    for (uint64_t pos = 0; pos < entry.compressedSize;) {
+        // Compressed bytes come from out (passthrough), the mapping or a read.
+        size_t n = static_cast<size_t>(std::min<uint64_t>(kReadChunk, entry.compressedSize - pos));
+        const void* chunk;
+        if (passthrough) {
+            chunk = out + pos;
+        } else if (file.Data()) {
+            if (entry.dataOffset + entry.compressedSize > file.Size()) {
+                throw std::runtime_error("Data of file lies outside the archive: " + entryPath);
+            }
+            chunk = file.Data() + entry.dataOffset + pos;
+        } else {
+            in.resize(n);
+            if (!file.ReadAt(in.data(), n, entry.dataOffset + pos)) {
+                throw std::runtime_error("Could not read data of file: " + entryPath);
+            }
+            chunk = in.data();
+        }
+        pos += n;
+
+        ZSTD_inBuffer input = { chunk, n, 0 };
+        while (input.pos < input.size) {
+            const size_t inBefore = input.pos, outBefore = output.pos;
+            size_t const ret = ZSTD_decompressStream(dctx, &output, &input);
+            if (ZSTD_isError(ret)) {
+                throw std::runtime_error("ZSTD_decompressStream error");
+            }
+            if (passthrough) {
+                crc = detail::Crc32Update(crc, decoded, output.pos);
+                decodedSize += output.pos;
+                output.pos = 0;
+                if (decodedSize > entry.originalSize) {
+                    throw std::runtime_error("Decoded data larger than recorded for file: " + entryPath);
+                }
+            } else if (input.pos == inBefore && output.pos == outBefore) {
+                throw std::runtime_error("Decoded data larger than recorded for file: " + entryPath);
+            }
+        }
+    }
+    if (!passthrough) decodedSize = output.pos;
+    if (decodedSize != entry.originalSize) {
+        throw std::runtime_error("Decoded data shorter than recorded for file: " + entryPath);
+    }
+
+    if (filtered) {
+        if (auto filter = detail::CreateFilter(entry.filter, entry.filterParam, false)) {
+            std::vector<uint8_t> unfiltered;
+            unfiltered.reserve(scratch.size());
+            filter->Process(scratch.data(), scratch.size(), true, unfiltered);
+            memcpy(out, unfiltered.data(), unfiltered.size());
+        } else {
+            memcpy(out, scratch.data(), scratch.size());
+        }
+    }
+    if (!passthrough) crc = detail::Crc32Update(0, out, entry.originalSize);
+    if (crc != entry.crc32) {
+        throw std::runtime_error("CRC32 mismatch for file: " + entryPath);
+    }
+  }
+
+  std::vector<uint8_t> ArchiveReader::Impl::ReadChunks(const ACFEntryData& entry, const std::string& entryPath) const
+  {
+    std::vector<detail::ChunkRef> refs(entry.compressedSize / sizeof(detail::ChunkRef));
+    if (!file.ReadAt(refs.data(), refs.size() * sizeof(detail::ChunkRef), entry.dataOffset)) {
+        throw std::runtime_error("Could not read chunk references for file: " + entryPath);
+    }
+    detail::ChunkRepository& repository = Repository();
+    std::vector<uint8_t> data;
+    data.reserve(entry.originalSize);
+    for (const auto& ref : refs) {
+        auto chunk = repository.Get(ref.hash);
+        data.insert(data.end(), chunk->begin(), chunk->end());
+    }
+    if (detail::Crc32Update(0, data.data(), data.size()) != entry.crc32) {
+        throw std::runtime_error("CRC32 mismatch for file: " + entryPath);
+    }
+    return data;
+  }
+
+  // --- Lazily Decoded Files ---
+  class ArchiveFile::Impl
+  {
+  public:
+    Impl(const ArchiveReader::Impl& owner, size_t entryIndex);
+    size_t Read(uint64_t offset, uint8_t* buffer, size_t length);
+
+    const ArchiveReader::Impl& reader;
+    const size_t index;
+    const ACFEntryData& entry;
+    const std::string& path;
+    const uint64_t size;
+
+  private:
+    BlockCache::Block GetBlock(uint64_t block);
+    // Decodes block m_NextBlock, which follows the last one decoded.
+    BlockCache::Block DecodeNext();
+    void Restart();
+    size_t ReadChunks(uint64_t offset, uint8_t* buffer, size_t length);
+
+    BlockCache::Block m_Last;
+    uint64_t m_LastIndex = 0;
+
+    // Frame decoder state
+    ZSTD_DCtx_Ptr m_DCtx;
+    std::vector<uint8_t> m_Prefix;
+    bool m_HasPrefix = false;
+    std::unique_ptr<detail::Filter> m_Filter;
+    std::vector<char> m_In;
+    ZSTD_inBuffer m_Input = { nullptr, 0, 0 };
+    uint64_t m_ReadPos = 0;     // Compressed bytes read
+    uint64_t m_Decoded = 0;     // Bytes out of the decoder, before the filter
+    std::vector<uint8_t> m_Out;
+    std::vector<uint8_t> m_Pending; // Decoded bytes not cut into a block yet
+    uint64_t m_NextBlock = 0;
+    uint32_t m_Crc = 0;
+
+    // Chunk references with the content offset of each chunk, plus the total
+    std::vector<detail::ChunkRef> m_Refs;
+    std::vector<uint64_t> m_RefOffsets;
+    std::shared_ptr<const std::vector<uint8_t>> m_Chunk;
+    size_t m_ChunkIndex = 0;
+  };
+
+  ArchiveFile::Impl::Impl(const ArchiveReader::Impl& owner, size_t entryIndex)
+      : reader(owner), index(entryIndex), entry(owner.entries[entryIndex].first),
+        path(owner.entries[entryIndex].second), size(ContentSize(entry))
+  {
+    if (entry.type != EntryType::File) {
+        throw std::runtime_error("Cannot extract data from a directory entry: " + path);
+    }
+    if (entry.method == CompressionMethod::ChunkRef) {
+        m_Refs.resize(entry.compressedSize / sizeof(detail::ChunkRef));
+        if (!reader.file.ReadAt(m_Refs.data(), m_Refs.size() * sizeof(detail::ChunkRef), entry.dataOffset)) {
+            throw std::runtime_error("Could not read chunk references for file: " + path);
+        }
+        m_RefOffsets.push_back(0);
+        for (const auto& ref : m_Refs) m_RefOffsets.push_back(m_RefOffsets.back() + ref.size);
+        if (m_RefOffsets.back() != size) {
+            throw std::runtime_error("Chunk references do not cover file: " + path);
+        }
+    } else if (entry.method != CompressionMethod::ZstdPassthrough && entry.method != CompressionMethod::Uncompressed) {
+        m_HasPrefix = reader.Prefix(entry, path, m_Prefix);
+    }
+  }
+
+  void ArchiveFile::Impl::Restart()
+  {
+    if (!m_DCtx) {
+        m_DCtx.reset(ZSTD_createDCtx());
+        if (!m_DCtx) throw std::runtime_error("ZSTD_createDCtx() error");
+        m_In.resize(std::min<uint64_t>(kReadChunk, std::max<uint64_t>(entry.compressedSize, 1)));
+        m_Out.resize(BlockCache::kBlockSize);
+    }
+    ZSTD_DCtx_reset(m_DCtx.get(), ZSTD_reset_session_and_parameters);
+    ZSTD_DCtx_setParameter(m_DCtx.get(), ZSTD_d_windowLogMax, entry.windowLog ? entry.windowLog : detail::kDefaultWindowLogMax);
+    if (m_HasPrefix) ZSTD_DCtx_refPrefix(m_DCtx.get(), m_Prefix.data(), m_Prefix.size());
+    m_Filter = detail::CreateFilter(entry.filter, entry.filterParam, false);
+    m_Input = { nullptr, 0, 0 };
+    m_ReadPos = 0;
+    m_Decoded = 0;
+    m_Pending.clear();
+    m_NextBlock = 0;
+    m_Crc = 0;
+  }
+
+  BlockCache::Block ArchiveFile::Impl::DecodeNext()
+  {
+    const uint64_t start = m_NextBlock * BlockCache::kBlockSize;
+    const size_t want = static_cast<size_t>(std::min<uint64_t>(BlockCache::kBlockSize, size - start));
+    while (m_Pending.size() < want) {
+        if (m_Decoded == entry.originalSize) {
+            throw std::runtime_error("Decoded data shorter than recorded for file: " + path);
+        }
+        if (m_Input.pos == m_Input.size) {
+            if (m_ReadPos == entry.compressedSize) {
+                throw std::runtime_error("Decoded data shorter than recorded for file: " + path);
+            }
+            size_t n = static_cast<size_t>(std::min<uint64_t>(m_In.size(), entry.compressedSize - m_ReadPos));
+            if (!reader.file.ReadAt(m_In.data(), n, entry.dataOffset + m_ReadPos)) {
+                throw std::runtime_error("Could not read data of file: " + path);
+            }
+            m_ReadPos += n;
+            m_Input = { m_In.data(), n, 0 };
+        }
+        ZSTD_outBuffer output = { m_Out.data(), static_cast<size_t>(std::min<uint64_t>(m_Out.size(), entry.originalSize - m_Decoded)), 0 };
+        size_t const ret = ZSTD_decompressStream(m_DCtx.get(), &output, &m_Input);
+        if (ZSTD_isError(ret)) {
+            throw std::runtime_error("ZSTD_decompressStream error");
+        }
+        m_Decoded += output.pos;
+        if (m_Filter) {
+            m_Filter->Process(m_Out.data(), output.pos, m_Decoded == entry.originalSize, m_Pending);
+        } else {
+            m_Pending.insert(m_Pending.end(), m_Out.data(), m_Out.data() + output.pos);
+        }
+    }
+
+    auto block = std::make_shared<const std::vector<uint8_t>>(m_Pending.begin(), m_Pending.begin() + want);
+    m_Pending.erase(m_Pending.begin(), m_Pending.begin() + want);
+    m_Crc = detail::Crc32Update(m_Crc, block->data(), block->size());
+    ++m_NextBlock;
+    if (start + want == size && m_Crc != entry.crc32) {
+        throw std::runtime_error("CRC32 mismatch for file: " + path);
+    }
+    return block;
+  }
+
+  BlockCache::Block ArchiveFile::Impl::GetBlock(uint64_t block)
+  {
+    if (m_Last && m_LastIndex == block) return m_Last;
+    BlockCache* cache = reader.options.cache.get();
+    BlockCache::Block found = cache ? cache->Find(reader.id, index, block) : nullptr;
+    if (!found) {
+        if (!m_DCtx || block < m_NextBlock) Restart();
+        while (!found) {
+            const uint64_t decoded = m_NextBlock;
+            BlockCache::Block next = DecodeNext();
+            if (cache) cache->Insert(reader.id, index, decoded, next);
+            if (decoded == block) found = std::move(next);
+        }
+    }
+    m_Last = found;
+    m_LastIndex = block;
+    return found;
+  }
+
+  size_t ArchiveFile::Impl::ReadChunks(uint64_t offset, uint8_t* buffer, size_t length)
+  {
+    size_t done = 0;
+    while (done < length) {
+        const uint64_t pos = offset + done;
+        size_t i = std::upper_bound(m_RefOffsets.begin(), m_RefOffsets.end(), pos) - m_RefOffsets.begin() - 1;
+        if (!m_Chunk || m_ChunkIndex != i) {
+            m_Chunk = reader.Repository().Get(m_Refs[i].hash);
+            m_ChunkIndex = i;
+            if (m_Chunk->size() != m_Refs[i].size) {
+                throw std::runtime_error("Chunk size mismatch for file: " + path);
+            }
+        }
+        const size_t within = static_cast<size_t>(pos - m_RefOffsets[i]);
+        const size_t n = std::min(length - done, m_Chunk->size() - within);
+        memcpy(buffer + done, m_Chunk->data() + within, n);
+        done += n;
+    }
+    return done;
+  }
+
+  size_t ArchiveFile::Impl::Read(uint64_t offset, uint8_t* buffer, size_t length)
+  {
+    if (offset >= size) return 0;
+    length = static_cast<size_t>(std::min<uint64_t>(length, size - offset));
+
+    if (entry.method == CompressionMethod::ZstdPassthrough || entry.method == CompressionMethod::Uncompressed) {
+        if (!reader.file.ReadAt(buffer, length, entry.dataOffset + offset)) {
+            throw std::runtime_error("Could not read data of file: " + path);
+        }
+        return length;
+    }
+    if (entry.method == CompressionMethod::ChunkRef) {
+        return ReadChunks(offset, buffer, length);
+    }
+
+    size_t done = 0;
+    while (done < length) {
+        const uint64_t pos = offset + done;
+        BlockCache::Block block = GetBlock(pos / BlockCache::kBlockSize);
+        const size_t within = static_cast<size_t>(pos % BlockCache::kBlockSize);
+        const size_t n = std::min(length - done, block->size() - within);
+        memcpy(buffer + done, block->data() + within, n);
+        done += n;
+    }
+    return done;
+  }
+
+  ArchiveFile::ArchiveFile(std::unique_ptr<Impl> impl) : m_Impl(std::move(impl)) {}
+
+  ArchiveFile::~ArchiveFile() {}
+
+  const ACFEntryData& ArchiveFile::Entry() const {
+    return m_Impl->entry;
+  }
+
+  uint64_t ArchiveFile::Size() const {
+    return m_Impl->size;
+  }
+
+  size_t ArchiveFile::Read(uint64_t offset, void* buffer, size_t length) {
+    return m_Impl->Read(offset, static_cast<uint8_t*>(buffer), length);
+  }
+
+  // --- ArchiveReader ---
+  ArchiveReader::ArchiveReader(const std::string& archivePath, const ArchiveReaderOptions& options)
+      : m_Impl(std::make_unique<Impl>(archivePath, options)) {}
+
+  ArchiveReader::~ArchiveReader() {}
+
+  const std::string& ArchiveReader::Path() const {
+    return m_Impl->path;
+  }
+
+  const std::vector<std::pair<ACFEntryData, std::string>>& ArchiveReader::Entries() const {
+    return m_Impl->entries;
+  }
+
+  const ACFEntryData* ArchiveReader::Find(const std::string& path) const {
+    auto it = m_Impl->byPath.find(detail::NormalizeInternalPath(path));
+    return it != m_Impl->byPath.end() ? &m_Impl->entries[it->second].first : nullptr;
+  }
+
+  std::vector<uint8_t> ArchiveReader::Read(const std::string& path) const {
+    return m_Impl->Content(m_Impl->Lookup(path));
+  }
+
+  StoredFrame ArchiveReader::RawFrame(const std::string& path) const {
+    const ACFEntryData* entry = &m_Impl->entries[m_Impl->Lookup(path)].first;
+    if (entry->type != EntryType::File) {
+        throw std::runtime_error("Cannot extract data from a directory entry: " + path);
+    }
+    if ((entry->method != CompressionMethod::Zstd && entry->method != CompressionMethod::ZstdPassthrough) ||
+        entry->prefixOffset) {
+        throw std::runtime_error("File is not stored as self-contained frames: " + path);
+    }
+
+    StoredFrame frame;
+    frame.method = entry->method;
+    frame.originalSize = entry->originalSize;
+    frame.compressedSize = entry->compressedSize;
+    frame.crc32 = entry->crc32;
+    frame.windowLog = entry->windowLog;
+    frame.filter = entry->filter;
+    frame.filterParam = entry->filterParam;
+    frame.filedatetime = entry->filedatetime;
+    frame.fileattribute = entry->fileattribute;
+    frame.unixMode = entry->unixMode;
+
+    const platform::RandomAccessFile& file = m_Impl->file;
+    if (entry->dataOffset + entry->compressedSize > file.Size()) {
+        throw std::runtime_error("Data of file lies outside the archive: " + path);
+    }
+    if (file.Data()) {
+        frame.data = std::span<const uint8_t>(file.Data() + entry->dataOffset, entry->compressedSize);
+        return frame;
+    }
+    auto copy = std::make_shared<std::vector<uint8_t>>(entry->compressedSize);
+    if (!file.ReadAt(copy->data(), copy->size(), entry->dataOffset)) {
+        throw std::runtime_error("Could not read data of file: " + path);
+    }
+    frame.data = std::span<const uint8_t>(copy->data(), copy->size());
+    frame.owner = std::move(copy);
+    return frame;
+  }
+
+  std::span<const uint8_t> ArchiveReader::MappedData(const std::string& path) const {
+    const ACFEntryData* entry = &m_Impl->entries[m_Impl->Lookup(path)].first;
+    if (entry->type != EntryType::File || entry->method != CompressionMethod::Uncompressed) {
+        throw std::runtime_error("File is not stored uncompressed: " + path);
+    }
+    const platform::RandomAccessFile& file = m_Impl->file;
+    if (!file.Data()) {
+        throw std::runtime_error("Archive is not mapped: " + m_Impl->path);
+    }
+    if (entry->dataOffset + entry->originalSize > file.Size()) {
+        throw std::runtime_error("Data of file lies outside the archive: " + path);
+    }
+    return std::span<const uint8_t>(file.Data() + entry->dataOffset, entry->originalSize);
+  }
+
+  LoadedArchive ArchiveReader::LoadAll(unsigned threads) const {
+    struct Item
+    {
+      size_t index;
+      uint64_t offset; // Into the arena
+    };
+    std::vector<Item> items;
+    for (size_t i = 0; i < m_Impl->entries.size(); ++i) {
+        if (m_Impl->entries[i].first.type == EntryType::File) items.push_back({i, 0});
+    }
+    std::sort(items.begin(), items.end(), [this](const Item& a, const Item& b) {
+        return m_Impl->entries[a.index].first.dataOffset < m_Impl->entries[b.index].first.dataOffset;
+    });
+
+    LoadedArchive loaded;
+    for (auto& item : items) {
+        item.offset = loaded.size;
+        loaded.size += ContentSize(m_Impl->entries[item.index].first);
+    }
+    if (loaded.size > SIZE_MAX) {
+        throw std::runtime_error("Archive content does not fit in memory: " + m_Impl->path);
+    }
+    loaded.arena = std::make_unique_for_overwrite<uint8_t[]>(static_cast<size_t>(std::max<uint64_t>(loaded.size, 1)));
+
+    // Members of a similarity group are primed with their group's first
+    // file, which is stored before them and decoded into the arena first.
+    std::unordered_map<size_t, size_t> itemOf; // Entry index -> item
+    for (size_t i = 0; i < items.size(); ++i) itemOf.emplace(items[i].index, i);
+    std::vector<std::atomic<bool>> done(items.size());
+
+    // Workers take files in storage order, so reads stay close to sequential.
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto work = [&] {
+        while (!failed) {
+            const size_t i = next++;
+            if (i >= items.size()) break;
+            const auto& [entry, entryPath] = m_Impl->entries[items[i].index];
+            try {
+                auto prefixIt = entry.prefixOffset && entry.method == CompressionMethod::Zstd
+                                    ? m_Impl->byOffset.find(entry.prefixOffset) : m_Impl->byOffset.end();
+                // Only an earlier item can be waited for: it was taken already.
+                const size_t p = prefixIt != m_Impl->byOffset.end() ? itemOf.at(prefixIt->second) : i;
+                if (p < i && !m_Impl->entries[prefixIt->second].first.prefixOffset) {
+                    done[p].wait(false);
+                    if (failed) throw std::runtime_error("Prefix entry failed for file: " + entryPath);
+                    std::span<const uint8_t> prefix(loaded.arena.get() + items[p].offset,
+                                                    ContentSize(m_Impl->entries[prefixIt->second].first));
+                    m_Impl->ReadEntryTo(entry, entryPath, loaded.arena.get() + items[i].offset, &prefix);
+                } else {
+                    m_Impl->ReadEntryTo(entry, entryPath, loaded.arena.get() + items[i].offset);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) error = std::current_exception();
+                failed = true;
+            }
+            done[i] = true;
+            done[i].notify_all();
+        }
+    };
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(items.size(), 1)));
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) workers.emplace_back(work);
+    work();
+    for (auto& worker : workers) worker.join();
+    if (error) std::rethrow_exception(error);
+
+    loaded.files.reserve(items.size());
+    for (const auto& item : items) {
+        const auto& [entry, entryPath] = m_Impl->entries[item.index];
+        loaded.files.emplace(entryPath, std::span<const uint8_t>(loaded.arena.get() + item.offset, ContentSize(entry)));
+    }
+    return loaded;
+  }
+
+  std::unique_ptr<ArchiveFile> ArchiveReader::Open(const std::string& path) const {
+    return std::unique_ptr<ArchiveFile>(new ArchiveFile(std::make_unique<ArchiveFile::Impl>(*m_Impl, m_Impl->Lookup(path))));
+  }
+
+  std::vector<std::string> ArchiveReader::AccessProfile() const {
+    std::lock_guard<std::mutex> lock(m_Impl->accessMutex);
+    std::vector<std::string> paths;
+    for (size_t index : m_Impl->accessOrder) {
+        if (m_Impl->entries[index].first.type == EntryType::File) paths.push_back(m_Impl->entries[index].second);
+    }
+    return paths;
+  }
+
+  void ArchiveReader::SaveAccessProfile(const std::string& profilePath) const {
+    std::ofstream out(profilePath, std::ios::trunc);
+    out << "# First-touch order of " << std::filesystem::path(m_Impl->path).filename().string() << "\n";
+    for (const auto& path : AccessProfile()) out << path << "\n";
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Could not write access profile: " + profilePath);
+    }
+  }
+
+  std::vector<std::string> LoadAccessProfile(const std::string& profilePath) {
+    std::ifstream in(profilePath);
+    if (!in) {
+        throw std::runtime_error("Could not open access profile: " + profilePath);
+    }
+    std::vector<std::string> paths;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        paths.push_back(detail::NormalizeInternalPath(line));
+    }
+    return paths;
+  }
+
+} // namespace acf
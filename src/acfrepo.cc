@@ -0,0 +1,529 @@
+#include "acfrepo.hh"
+#include <stdexcept>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_set>
+
+namespace {
+
+namespace fs = std::filesystem;
+using acf::detail::ChunkHash;
+using acf::detail::ChunkHashHasher;
+
+// --- SHA-256 ---
+const uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+uint32_t Rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+void Sha256Block(uint32_t state[8], const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+               (static_cast<uint32_t>(block[i * 4 + 2]) << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + kSha256K[i] + w[i];
+        uint32_t t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+// --- Content-Defined Chunking ---
+constexpr size_t kMinChunk = 16 << 10;
+constexpr size_t kMaxChunk = 256 << 10;
+constexpr int kChunkBits = 16; // Average distance between boundaries past kMinChunk
+
+// Fixed gear table: changing it would change every chunk boundary and with
+// them all deduplication against existing repositories.
+struct GearTable
+{
+    uint64_t values[256];
+    GearTable() {
+        uint64_t x = 0x41434643444321ull;
+        for (auto& v : values) {
+            x += 0x9E3779B97F4A7C15ull; // SplitMix64
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            v = z ^ (z >> 31);
+        }
+    }
+};
+const GearTable kGear;
+
+// Length of the next chunk at the start of data, or 0 if more data is needed.
+size_t FindBoundary(const uint8_t* data, size_t size, bool final) {
+    if (size <= kMinChunk) return final ? size : 0;
+    const size_t end = std::min(size, kMaxChunk);
+    uint64_t hash = 0;
+    for (size_t i = kMinChunk - 64; i < end; ++i) {
+        hash = (hash << 1) + kGear.values[data[i]];
+        if (i >= kMinChunk && (hash >> (64 - kChunkBits)) == 0) return i + 1;
+    }
+    if (end == kMaxChunk) return kMaxChunk;
+    return final ? size : 0;
+}
+
+// --- Shared Chunk Cache ---
+// Decoded chunks of all repositories in the process, least recently used
+// dropped first. Keyed by content hash, so archives sharing chunks share entries.
+class ChunkCache
+{
+public:
+    static constexpr size_t kCapacity = 64 << 20;
+
+    std::shared_ptr<const std::vector<uint8_t>> Find(const ChunkHash& hash) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto it = m_Map.find(hash);
+        if (it == m_Map.end()) return nullptr;
+        m_Lru.splice(m_Lru.begin(), m_Lru, it->second);
+        return it->second->second;
+    }
+
+    void Insert(const ChunkHash& hash, std::shared_ptr<const std::vector<uint8_t>> data) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Map.count(hash)) return;
+        m_Size += data->size();
+        m_Lru.emplace_front(hash, std::move(data));
+        m_Map[hash] = m_Lru.begin();
+        while (m_Size > kCapacity && m_Lru.size() > 1) {
+            m_Size -= m_Lru.back().second->size();
+            m_Map.erase(m_Lru.back().first);
+            m_Lru.pop_back();
+        }
+    }
+
+private:
+    using Entry = std::pair<ChunkHash, std::shared_ptr<const std::vector<uint8_t>>>;
+    std::mutex m_Mutex;
+    std::list<Entry> m_Lru;
+    std::unordered_map<ChunkHash, std::list<Entry>::iterator, ChunkHashHasher> m_Map;
+    size_t m_Size = 0;
+};
+
+ChunkCache& SharedChunkCache() {
+    static ChunkCache cache;
+    return cache;
+}
+
+// --- Repository Files ---
+constexpr uint32_t kIndexMagic = 0x49464341; // "ACFI"
+constexpr uint32_t kIndexVersion = 1;
+
+#pragma pack(push, 1)
+struct IndexRecord
+{
+    ChunkHash hash;
+    uint32_t pack;
+    uint64_t offset;
+    uint32_t compressedSize;
+    uint32_t size;
+};
+#pragma pack(pop)
+
+std::vector<std::string> ReadLines(const fs::path& p) {
+    std::vector<std::string> lines;
+    std::ifstream in(p);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty()) lines.push_back(line);
+    }
+    return lines;
+}
+
+// Replaces a repository file atomically: readers see the old or the new version.
+void WriteReplace(const fs::path& p, const std::function<void(std::ofstream&)>& write) {
+    fs::path tmp = p;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Could not write repository file: " + tmp.string());
+        write(out);
+        if (!out) throw std::runtime_error("Could not write repository file: " + tmp.string());
+    }
+    fs::rename(tmp, p);
+}
+
+// Calls visit for every chunk reference of a manifest's ChunkRef entries.
+void ForEachChunkRef(const std::string& archive, const std::function<void(const acf::detail::ChunkRef&)>& visit) {
+    using acf::detail::ChunkRef;
+    acf::ACFArchiver reader;
+    std::ifstream in(archive, std::ios::binary);
+    for (const auto& [entry, path] : reader.List(archive)) {
+        if (entry.type != acf::EntryType::File || entry.method != acf::CompressionMethod::ChunkRef) continue;
+        std::vector<ChunkRef> refs(entry.compressedSize / sizeof(ChunkRef));
+        in.seekg(entry.dataOffset);
+        if (!in.read(reinterpret_cast<char*>(refs.data()), refs.size() * sizeof(ChunkRef))) {
+            throw std::runtime_error("Could not read chunk references of " + path + " in " + archive);
+        }
+        for (const auto& ref : refs) visit(ref);
+    }
+}
+
+} // namespace
+
+namespace acf::detail
+{
+  size_t ChunkHashHasher::operator()(const ChunkHash& h) const {
+    size_t v;
+    memcpy(&v, h.data(), sizeof(v));
+    return v;
+  }
+
+  ChunkHash Sha256(const uint8_t* data, size_t size)
+  {
+    uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    size_t pos = 0;
+    for (; pos + 64 <= size; pos += 64) Sha256Block(state, data + pos);
+
+    uint8_t tail[128] = {};
+    size_t rest = size - pos;
+    memcpy(tail, data + pos, rest);
+    tail[rest] = 0x80;
+    size_t tailSize = rest + 9 <= 64 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+    for (int i = 0; i < 8; ++i) tail[tailSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    for (size_t off = 0; off < tailSize; off += 64) Sha256Block(state, tail + off);
+
+    ChunkHash hash;
+    for (int i = 0; i < 8; ++i) {
+        hash[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        hash[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        hash[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        hash[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+    return hash;
+  }
+
+  void Chunker::Feed(const uint8_t* data, size_t size, const Emit& emit)
+  {
+    m_Buffer.insert(m_Buffer.end(), data, data + size);
+    size_t start = 0;
+    while (size_t cut = FindBoundary(m_Buffer.data() + start, m_Buffer.size() - start, false)) {
+        emit(m_Buffer.data() + start, cut);
+        start += cut;
+    }
+    m_Buffer.erase(m_Buffer.begin(), m_Buffer.begin() + start);
+  }
+
+  void Chunker::Finish(const Emit& emit)
+  {
+    size_t start = 0;
+    while (start < m_Buffer.size()) {
+        size_t cut = FindBoundary(m_Buffer.data() + start, m_Buffer.size() - start, true);
+        emit(m_Buffer.data() + start, cut);
+        start += cut;
+    }
+    m_Buffer.clear();
+  }
+
+  std::shared_ptr<ChunkRepository> ChunkRepository::Open(const std::string& path, bool create, bool exclusive)
+  {
+    if (create) {
+        fs::create_directories(fs::path(path) / "packs");
+    } else if (!fs::exists(fs::path(path) / "index") && !fs::is_directory(fs::path(path) / "packs")) {
+        throw std::runtime_error("Not a chunk repository: " + path);
+    }
+    std::shared_ptr<ChunkRepository> repo(new ChunkRepository(path));
+    // Pack numbers and the index are only stable while the lock is held.
+    if (exclusive && !repo->m_Lock.TryLock(fs::path(path) / "lock")) {
+        throw std::runtime_error("Chunk repository is in use by another writer: " + path);
+    }
+    repo->LoadIndex();
+    return repo;
+  }
+
+  ChunkRepository::~ChunkRepository()
+  {
+    ZSTD_freeCCtx(m_CCtx);
+  }
+
+  std::string ChunkRepository::PackPath(uint32_t pack) const
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "%08u.pack", pack);
+    return (fs::path(m_Path) / "packs" / name).string();
+  }
+
+  void ChunkRepository::LoadIndex()
+  {
+    // Pack numbers continue after every pack on disk, indexed or not, so an
+    // interrupted writer's pack is never appended to.
+    std::error_code ec;
+    for (const auto& item : fs::directory_iterator(fs::path(m_Path) / "packs", ec)) {
+        if (item.path().extension() != ".pack") continue;
+        uint32_t pack = static_cast<uint32_t>(std::strtoul(item.path().stem().string().c_str(), nullptr, 10));
+        m_NextPack = std::max(m_NextPack, pack + 1);
+    }
+
+    std::ifstream in(fs::path(m_Path) / "index", std::ios::binary);
+    if (!in) return;
+    uint32_t magic = 0, version = 0;
+    uint64_t count = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || magic != kIndexMagic || version != kIndexVersion) {
+        throw std::runtime_error("Invalid chunk repository index: " + m_Path);
+    }
+    m_Index.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        IndexRecord record;
+        if (!in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            throw std::runtime_error("Truncated chunk repository index: " + m_Path);
+        }
+        m_Index[record.hash] = { record.pack, record.offset, record.compressedSize, record.size };
+    }
+  }
+
+  void ChunkRepository::SaveIndex()
+  {
+    WriteReplace(fs::path(m_Path) / "index", [&](std::ofstream& out) {
+        uint64_t count = m_Index.size();
+        out.write(reinterpret_cast<const char*>(&kIndexMagic), sizeof(kIndexMagic));
+        out.write(reinterpret_cast<const char*>(&kIndexVersion), sizeof(kIndexVersion));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& [hash, loc] : m_Index) {
+            IndexRecord record{ hash, loc.pack, loc.offset, loc.compressedSize, loc.size };
+            out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+    });
+  }
+
+  ChunkRepository::Location ChunkRepository::Append(const ChunkHash& hash, const char* frame, uint32_t compressedSize, uint32_t size)
+  {
+    if (!m_Writer.is_open()) {
+        m_WriterPack = m_NextPack++;
+        m_WriterOffset = 0;
+        m_Writer.open(PackPath(m_WriterPack), std::ios::binary | std::ios::trunc);
+        if (!m_Writer) throw std::runtime_error("Could not create pack file: " + PackPath(m_WriterPack));
+    }
+    m_Writer.write(frame, compressedSize);
+    Location loc{ m_WriterPack, m_WriterOffset, compressedSize, size };
+    m_WriterOffset += compressedSize;
+    m_Index[hash] = loc;
+    m_Dirty = true;
+    return loc;
+  }
+
+  ChunkRef ChunkRepository::Put(const uint8_t* data, size_t size, int level)
+  {
+    ChunkRef ref{ Sha256(data, size), static_cast<uint32_t>(size) };
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Index.count(ref.hash)) return ref;
+
+    if (!m_CCtx && !(m_CCtx = ZSTD_createCCtx())) throw std::runtime_error("ZSTD_createCCtx() error");
+    m_CompressBuffer.resize(ZSTD_compressBound(size));
+    size_t csize = ZSTD_compressCCtx(m_CCtx, m_CompressBuffer.data(), m_CompressBuffer.size(), data, size, level);
+    if (ZSTD_isError(csize)) throw std::runtime_error("ZSTD_compress error");
+    Append(ref.hash, m_CompressBuffer.data(), static_cast<uint32_t>(csize), ref.size);
+    return ref;
+  }
+
+  std::shared_ptr<const std::vector<uint8_t>> ChunkRepository::Get(const ChunkHash& hash)
+  {
+    if (auto cached = SharedChunkCache().Find(hash)) return cached;
+
+    // Garbage collection may have moved the chunk to another pack since the
+    // index was loaded, and its old pack may be gone or its number reused. A
+    // reader with nothing of its own to save then picks up the current index
+    // and tries once more.
+    for (int attempt = 0;; ++attempt) {
+        std::vector<char> frame;
+        Location loc;
+        bool read;
+        bool canReload;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (attempt) {
+                m_Index.clear();
+                m_Readers.clear();
+                LoadIndex();
+            }
+            canReload = !attempt && !m_Dirty && !m_Writer.is_open();
+            auto it = m_Index.find(hash);
+            if (it == m_Index.end()) {
+                if (canReload) continue;
+                throw std::runtime_error("Chunk missing from repository: " + m_Path);
+            }
+            loc = it->second;
+            if (m_Writer.is_open() && loc.pack == m_WriterPack) m_Writer.flush();
+
+            std::ifstream& reader = m_Readers[loc.pack];
+            if (!reader.is_open()) reader.open(PackPath(loc.pack), std::ios::binary);
+            frame.resize(loc.compressedSize);
+            reader.clear();
+            reader.seekg(loc.offset);
+            read = static_cast<bool>(reader.read(frame.data(), frame.size()));
+        }
+        if (!read) {
+            if (canReload) continue;
+            throw std::runtime_error("Could not read chunk from pack: " + PackPath(loc.pack));
+        }
+
+        auto data = std::make_shared<std::vector<uint8_t>>(loc.size);
+        size_t dsize = ZSTD_decompress(data->data(), data->size(), frame.data(), frame.size());
+        if (ZSTD_isError(dsize) || dsize != loc.size) {
+            if (canReload) continue;
+            throw std::runtime_error("Corrupted chunk in pack: " + PackPath(loc.pack));
+        }
+        SharedChunkCache().Insert(hash, data);
+        return data;
+    }
+  }
+
+  void ChunkRepository::Commit()
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Writer.is_open()) {
+        m_Writer.close();
+        if (!m_Writer) throw std::runtime_error("Could not write pack file: " + PackPath(m_WriterPack));
+        m_Readers.erase(m_WriterPack);
+    }
+    if (m_Dirty) {
+        SaveIndex();
+        m_Dirty = false;
+    }
+  }
+
+  void ChunkRepository::RegisterManifest(const std::string& archivePath)
+  {
+    const std::string absolute = fs::absolute(archivePath).lexically_normal().string();
+    const fs::path listPath = fs::path(m_Path) / "archives";
+    std::vector<std::string> archives = ReadLines(listPath);
+    if (std::find(archives.begin(), archives.end(), absolute) != archives.end()) return;
+    archives.push_back(absolute);
+    WriteReplace(listPath, [&](std::ofstream& out) {
+        for (const auto& a : archives) out << a << '\n';
+    });
+  }
+
+  void ChunkRepository::UnregisterManifest(const std::string& archivePath)
+  {
+    const std::string absolute = fs::absolute(archivePath).lexically_normal().string();
+    const fs::path listPath = fs::path(m_Path) / "archives";
+    std::vector<std::string> archives = ReadLines(listPath);
+    auto it = std::find(archives.begin(), archives.end(), absolute);
+    if (it == archives.end()) throw std::runtime_error("Manifest is not listed by the repository: " + absolute);
+    archives.erase(it);
+    WriteReplace(listPath, [&](std::ofstream& out) {
+        for (const auto& a : archives) out << a << '\n';
+    });
+  }
+
+} // namespace acf::detail
+
+namespace acf
+{
+  RepositoryGCStats CollectRepositoryGarbage(const std::string& repositoryPath, bool force)
+  {
+    RepositoryGCStats stats;
+    auto repo = detail::ChunkRepository::Open(repositoryPath, false, true);
+
+    // Everything referenced by a listed manifest is live. A manifest that is
+    // not found may only be out of reach, so its chunks are kept unless forced.
+    std::vector<std::string> archives;
+    std::vector<std::string> missing;
+    for (const auto& archive : ReadLines(fs::path(repositoryPath) / "archives")) {
+        (fs::exists(archive) ? archives : missing).push_back(archive);
+    }
+    stats.archives = archives.size();
+    stats.missingArchives = missing.size();
+    if (!missing.empty() && !force) {
+        std::string names;
+        for (const auto& archive : missing) names += "\n  " + archive;
+        throw std::runtime_error("Listed manifests not found, nothing removed (register moved ones again, "
+                                 "unregister deleted ones or force):" + names);
+    }
+
+    std::unordered_set<ChunkHash, ChunkHashHasher> live;
+    for (const auto& archive : archives) {
+        ForEachChunkRef(archive, [&](const detail::ChunkRef& ref) { live.insert(ref.hash); });
+    }
+
+    // Packs holding dead chunks are rewritten with their live chunks only.
+    std::map<uint32_t, std::vector<ChunkHash>> byPack;
+    for (const auto& [hash, loc] : repo->m_Index) byPack[loc.pack].push_back(hash);
+    std::vector<uint32_t> obsolete;
+    for (auto& [pack, hashes] : byPack) {
+        size_t dead = std::count_if(hashes.begin(), hashes.end(), [&](const ChunkHash& h) { return !live.count(h); });
+        if (dead == 0) {
+            stats.liveChunks += hashes.size();
+            continue;
+        }
+        std::sort(hashes.begin(), hashes.end(), [&](const ChunkHash& a, const ChunkHash& b) {
+            return repo->m_Index[a].offset < repo->m_Index[b].offset;
+        });
+        std::ifstream in(repo->PackPath(pack), std::ios::binary);
+        std::vector<char> frame;
+        for (const auto& hash : hashes) {
+            auto loc = repo->m_Index[hash];
+            if (!live.count(hash)) {
+                stats.removedChunks++;
+                stats.removedBytes += loc.compressedSize;
+                repo->m_Index.erase(hash);
+                continue;
+            }
+            frame.resize(loc.compressedSize);
+            in.seekg(loc.offset);
+            if (!in.read(frame.data(), frame.size())) {
+                throw std::runtime_error("Could not read chunk from pack: " + repo->PackPath(pack));
+            }
+            repo->Append(hash, frame.data(), loc.compressedSize, loc.size);
+            stats.liveChunks++;
+        }
+        repo->m_Dirty = true;
+        obsolete.push_back(pack);
+        stats.packsRewritten++;
+    }
+
+    // Old packs go only once the index no longer points into them.
+    repo->Commit();
+    repo->m_Readers.clear();
+    for (uint32_t pack : obsolete) fs::remove(repo->PackPath(pack));
+    WriteReplace(fs::path(repositoryPath) / "archives", [&](std::ofstream& out) {
+        for (const auto& a : archives) out << a << '\n';
+    });
+    return stats;
+  }
+
+  void RegisterRepositoryManifest(const std::string& repositoryPath, const std::string& archivePath)
+  {
+    auto repo = detail::ChunkRepository::Open(repositoryPath, false, true);
+    ForEachChunkRef(archivePath, [&](const detail::ChunkRef& ref) {
+        if (!repo->m_Index.count(ref.hash)) {
+            throw std::runtime_error("Manifest references chunks missing from the repository: " + archivePath);
+        }
+    });
+    repo->RegisterManifest(archivePath);
+  }
+
+  void UnregisterRepositoryManifest(const std::string& repositoryPath, const std::string& archivePath)
+  {
+    detail::ChunkRepository::Open(repositoryPath, false, true)->UnregisterManifest(archivePath);
+  }
+
+} // namespace acf
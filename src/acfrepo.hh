@@ -0,0 +1,112 @@
+#pragma once
+#include "acf.hh"
+#include "acfplatform.hh"
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+
+// Content-addressed chunk repository. Chunks are cut at content-defined
+// boundaries, named by their SHA-256 and stored once, zstd-compressed, in
+// append-only pack files of a repository directory:
+//   <repo>/index         chunk hash -> pack, offset, sizes
+//   <repo>/archives      manifests (.acf) written into the repository
+//   <repo>/packs/N.pack  concatenated zstd frames
+//   <repo>/lock          held by the writer, garbage collection and list changes
+// One writer at a time, enforced by the lock; readers only need the index
+// and the packs.
+namespace acf::detail
+{
+  using ChunkHash = std::array<uint8_t, 32>;
+
+  struct ChunkHashHasher
+  {
+    size_t operator()(const ChunkHash& h) const;
+  };
+
+  ChunkHash Sha256(const uint8_t* data, size_t size);
+
+  #pragma pack(push, 1)
+  // Element of the reference list a ChunkRef entry stores in its manifest.
+  struct ChunkRef
+  {
+    ChunkHash hash;
+    uint32_t size;
+  };
+  #pragma pack(pop)
+
+  // Splits a stream into chunks of 16 KiB to 256 KiB (64 KiB on average)
+  // with a gear rolling hash, so an insertion only changes nearby chunks.
+  class Chunker
+  {
+  public:
+    using Emit = std::function<void(const uint8_t* data, size_t size)>;
+    void Feed(const uint8_t* data, size_t size, const Emit& emit);
+    void Finish(const Emit& emit);
+  private:
+    std::vector<uint8_t> m_Buffer;
+  };
+
+  class ChunkRepository
+  {
+  public:
+    // Opens (or with create, initialises) the repository at path. With
+    // exclusive the repository lock is taken before the index is read and
+    // held until the repository is destroyed; throws if another writer has it.
+    static std::shared_ptr<ChunkRepository> Open(const std::string& path, bool create, bool exclusive);
+
+    const std::string& Path() const { return m_Path; }
+    // Stores the chunk unless the repository already has it.
+    ChunkRef Put(const uint8_t* data, size_t size, int level);
+    // Decoded chunk, served from the process-wide chunk cache when possible.
+    std::shared_ptr<const std::vector<uint8_t>> Get(const ChunkHash& hash);
+    // Makes chunks stored since the last commit durable: closes the pack and
+    // rewrites the index.
+    void Commit();
+    // Adds or removes a manifest path in <repo>/archives; needs exclusive.
+    void RegisterManifest(const std::string& archivePath);
+    void UnregisterManifest(const std::string& archivePath);
+
+    ~ChunkRepository();
+
+  private:
+    struct Location
+    {
+      uint32_t pack;
+      uint64_t offset;
+      uint32_t compressedSize;
+      uint32_t size;
+    };
+
+    explicit ChunkRepository(const std::string& path) : m_Path(path) {}
+    void LoadIndex();
+    void SaveIndex();
+    // Writes a compressed chunk to the current pack and indexes it.
+    Location Append(const ChunkHash& hash, const char* frame, uint32_t compressedSize, uint32_t size);
+    std::string PackPath(uint32_t pack) const;
+
+    friend RepositoryGCStats acf::CollectRepositoryGarbage(const std::string& repositoryPath, bool force);
+    friend void acf::RegisterRepositoryManifest(const std::string& repositoryPath, const std::string& archivePath);
+
+    std::string m_Path;
+    platform::FileLock m_Lock;
+    std::mutex m_Mutex;
+    std::unordered_map<ChunkHash, Location, ChunkHashHasher> m_Index;
+    uint32_t m_NextPack = 0;
+    // Pack receiving new chunks, opened on the first Put() after a commit.
+    std::ofstream m_Writer;
+    uint32_t m_WriterPack = 0;
+    uint64_t m_WriterOffset = 0;
+    bool m_Dirty = false;
+    std::unordered_map<uint32_t, std::ifstream> m_Readers;
+    std::vector<char> m_CompressBuffer;
+    ZSTD_CCtx* m_CCtx = nullptr;
+  };
+
+} // namespace acf::detail
@@ -0,0 +1,494 @@
+// acfserve: answers HTTP GET and HEAD for the files of an archive (Linux).
+//
+// An entry whose stored data is one plain zstd stream (no prefix, patch or
+// filter, window within what HTTP clients must accept) goes out unchanged
+// with "Content-Encoding: zstd", copied by sendfile() from the archive. Stored
+// .zst inputs and uncompressed files go out as they are. Everything else, and every Range request,
+// is decoded through the archive's lazily decoded file handles.
+#include "acf.hh"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+namespace {
+
+constexpr size_t kMaxRequestHeader = 16 << 10;
+constexpr size_t kSendChunk = acf::BlockCache::kBlockSize;
+constexpr size_t kDefaultCacheMB = 256;
+constexpr size_t kDefaultMaxConnections = 64;
+constexpr int kDefaultTimeout = 30; // Seconds a connection may wait for the next request or stall
+constexpr uint32_t kZstdMagic = 0xFD2FB528;
+// Largest window a client of the zstd content coding has to support (RFC 9659).
+constexpr uint64_t kHttpZstdWindowMax = 8 << 20;
+
+struct Request
+{
+    std::string method;
+    std::string target;
+    std::string version;
+    std::map<std::string, std::string> headers; // Names lower-cased
+
+    std::string Header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it != headers.end() ? it->second : std::string();
+    }
+};
+
+std::string Lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+std::string Trim(const std::string& s) {
+    size_t first = s.find_first_not_of(" \t");
+    if (first == std::string::npos) return std::string();
+    return s.substr(first, s.find_last_not_of(" \t") - first + 1);
+}
+
+// Reads the next request head; bytes after it stay in `pending` for the next call.
+bool ReadRequest(int sock, std::string& pending, Request& request) {
+    size_t end;
+    while ((end = pending.find("\r\n\r\n")) == std::string::npos) {
+        if (pending.size() > kMaxRequestHeader) return false;
+        char buffer[4096];
+        ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+        if (n <= 0) return false;
+        pending.append(buffer, static_cast<size_t>(n));
+    }
+    std::string head = pending.substr(0, end);
+    pending.erase(0, end + 4);
+
+    size_t lineEnd = head.find("\r\n");
+    std::string line = head.substr(0, lineEnd);
+    size_t sp1 = line.find(' '), sp2 = line.rfind(' ');
+    if (sp1 == std::string::npos || sp2 == sp1) return false;
+    request = Request();
+    request.method = line.substr(0, sp1);
+    request.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    request.version = line.substr(sp2 + 1);
+
+    while (lineEnd != std::string::npos) {
+        size_t start = lineEnd + 2;
+        lineEnd = head.find("\r\n", start);
+        line = head.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            request.headers[Lower(Trim(line.substr(0, colon)))] = Trim(line.substr(colon + 1));
+        }
+    }
+    return true;
+}
+
+bool SendAll(int sock, const char* data, size_t size) {
+    while (size) {
+        ssize_t n = send(sock, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool SendFileRange(int sock, int fd, uint64_t offset, uint64_t length) {
+    off_t pos = static_cast<off_t>(offset);
+    while (length) {
+        ssize_t n = sendfile(sock, fd, &pos, static_cast<size_t>(std::min<uint64_t>(length, 1 << 30)));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        length -= static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+// Path of a request target: percent-decoded, without query or fragment.
+std::string TargetPath(const std::string& target) {
+    std::string raw = target.substr(0, target.find_first_of("?#"));
+    std::string path;
+    for (size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] == '%' && i + 2 < raw.size() && isxdigit(static_cast<unsigned char>(raw[i + 1])) &&
+            isxdigit(static_cast<unsigned char>(raw[i + 2]))) {
+            path += static_cast<char>(std::stoi(raw.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            path += raw[i];
+        }
+    }
+    return path;
+}
+
+// True unless Accept-Encoding leaves zstd out or gives it q=0.
+bool AcceptsZstd(const std::string& acceptEncoding) {
+    std::string list = Lower(acceptEncoding);
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        std::string item = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        size_t semi = item.find(';');
+        if (Trim(item.substr(0, semi)) == "zstd") {
+            if (semi == std::string::npos) return true;
+            std::string param = Trim(item.substr(semi + 1));
+            return !(param.compare(0, 2, "q=") == 0 && std::strtod(param.c_str() + 2, nullptr) == 0.0);
+        }
+        if (comma == std::string::npos) break;
+        start = comma + 1;
+    }
+    return false;
+}
+
+enum class RangeResult { None, Satisfiable, Unsatisfiable };
+
+// A single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range.
+// Anything else, including lists of ranges, is served whole.
+RangeResult ParseRange(const std::string& header, uint64_t size, uint64_t& first, uint64_t& last) {
+    if (header.compare(0, 6, "bytes=") != 0 || header.find(',') != std::string::npos) return RangeResult::None;
+    std::string spec = Trim(header.substr(6));
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos) return RangeResult::None;
+    std::string a = spec.substr(0, dash), b = spec.substr(dash + 1);
+    auto digits = [](const std::string& s) { return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos; };
+    if (a.empty()) {
+        if (!digits(b)) return RangeResult::None;
+        uint64_t suffix = std::stoull(b);
+        if (suffix == 0 || size == 0) return RangeResult::Unsatisfiable;
+        first = size - std::min(suffix, size);
+        last = size - 1;
+        return RangeResult::Satisfiable;
+    }
+    if (!digits(a) || (!b.empty() && !digits(b))) return RangeResult::None;
+    first = std::stoull(a);
+    last = b.empty() ? size - 1 : std::min<uint64_t>(std::stoull(b), size - 1);
+    if (first >= size || (!b.empty() && std::stoull(b) < first)) return RangeResult::Unsatisfiable;
+    return RangeResult::Satisfiable;
+}
+
+const char* ContentType(const std::string& path) {
+    static const std::map<std::string, const char*> types = {
+        { "html", "text/html; charset=utf-8" }, { "htm", "text/html; charset=utf-8" },
+        { "css", "text/css" }, { "js", "text/javascript" }, { "mjs", "text/javascript" },
+        { "json", "application/json" }, { "txt", "text/plain; charset=utf-8" },
+        { "xml", "application/xml" }, { "svg", "image/svg+xml" }, { "png", "image/png" },
+        { "jpg", "image/jpeg" }, { "jpeg", "image/jpeg" }, { "gif", "image/gif" },
+        { "webp", "image/webp" }, { "ico", "image/x-icon" }, { "wasm", "application/wasm" },
+        { "woff2", "font/woff2" }, { "pdf", "application/pdf" }, { "zst", "application/zstd" },
+    };
+    size_t dot = path.rfind('.');
+    if (dot != std::string::npos && path.find('/', dot) == std::string::npos) {
+        auto it = types.find(Lower(path.substr(dot + 1)));
+        if (it != types.end()) return it->second;
+    }
+    return "application/octet-stream";
+}
+
+// Window a zstd frame header asks for, or 0 if the frame is not one a
+// plain decoder can take (bad magic, dictionary ID).
+uint64_t FrameWindowSize(const uint8_t* header, size_t size) {
+    if (size < 6) return 0;
+    uint32_t magic;
+    memcpy(&magic, header, 4);
+    if (magic != kZstdMagic) return 0;
+    const uint8_t descriptor = header[4];
+    const bool singleSegment = descriptor & 0x20;
+    const size_t dictIdSize[] = { 0, 1, 2, 4 };
+    const size_t contentSizeSize[] = { singleSegment ? 1u : 0u, 2, 4, 8 };
+    size_t pos = 5;
+    uint64_t window = 0;
+    if (!singleSegment) {
+        const uint8_t wd = header[pos++];
+        const uint64_t base = 1ull << (10 + (wd >> 3));
+        window = base + (base / 8) * (wd & 7);
+    }
+    const size_t dictSize = dictIdSize[descriptor & 3];
+    for (size_t i = 0; i < dictSize; ++i) {
+        if (pos >= size || header[pos++]) return 0;
+    }
+    if (singleSegment) {
+        const size_t fcsSize = contentSizeSize[descriptor >> 6];
+        if (pos + fcsSize > size) return 0;
+        uint64_t contentSize = 0;
+        memcpy(&contentSize, header + pos, fcsSize);
+        if (fcsSize == 2) contentSize += 256;
+        window = std::max<uint64_t>(contentSize, 1);
+    }
+    return window;
+}
+
+class Server
+{
+public:
+    Server(const std::string& archivePath, const acf::ArchiveReaderOptions& options)
+        : m_Vfs(std::make_shared<acf::ArchiveReader>(archivePath, options))
+    {
+        m_ArchiveFd = open(archivePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_ArchiveFd < 0) throw std::runtime_error("Could not open archive file: " + archivePath);
+    }
+
+    ~Server() { close(m_ArchiveFd); }
+
+    // Serves requests of one connection until it closes or asks to.
+    void Serve(int sock) {
+        std::string pending;
+        Request request;
+        while (ReadRequest(sock, pending, request)) {
+            bool keepAlive = request.version == "HTTP/1.1" ? Lower(request.Header("connection")) != "close"
+                                                            : Lower(request.Header("connection")) == "keep-alive";
+            if (!Handle(sock, request, keepAlive) || !keepAlive) break;
+        }
+        close(sock);
+    }
+
+private:
+    bool SendHead(int sock, int status, const char* reason, const std::vector<std::string>& headers, bool keepAlive) {
+        std::string head = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+        for (const auto& header : headers) head += header + "\r\n";
+        head += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        return SendAll(sock, head.data(), head.size());
+    }
+
+    bool SendError(int sock, int status, const char* reason, bool keepAlive, const std::vector<std::string>& extra = {}) {
+        std::string body = std::to_string(status) + " " + reason + "\n";
+        std::vector<std::string> headers = { "Content-Type: text/plain", "Content-Length: " + std::to_string(body.size()) };
+        headers.insert(headers.end(), extra.begin(), extra.end());
+        return SendHead(sock, status, reason, headers, keepAlive) && SendAll(sock, body.data(), body.size());
+    }
+
+    // True when the stored bytes are a zstd stream any HTTP client can decode to the file.
+    bool StoredFrameServable(const acf::ACFEntryData& entry) const {
+        if (entry.method != acf::CompressionMethod::Zstd || entry.filter != acf::FilterType::None ||
+            entry.prefixOffset || entry.compressedSize == 0) {
+            return false;
+        }
+        uint8_t header[18] = {};
+        size_t n = static_cast<size_t>(std::min<uint64_t>(sizeof(header), entry.compressedSize));
+        if (pread(m_ArchiveFd, header, n, static_cast<off_t>(entry.dataOffset)) != static_cast<ssize_t>(n)) return false;
+        const uint64_t window = FrameWindowSize(header, n);
+        return window && window <= kHttpZstdWindowMax;
+    }
+
+    bool Handle(int sock, const Request& request, bool keepAlive) {
+        const bool head = request.method == "HEAD";
+        if (request.method != "GET" && !head) {
+            return SendError(sock, 405, "Method Not Allowed", keepAlive, { "Allow: GET, HEAD" });
+        }
+        const std::string path = TargetPath(request.target);
+        acf::VfsStat stat;
+        if (!m_Vfs.Stat(path, stat) || stat.directory) {
+            return SendError(sock, 404, "Not Found", keepAlive);
+        }
+        const acf::ACFEntryData& entry = *m_Vfs.Find(path);
+
+        uint64_t first = 0, last = stat.size ? stat.size - 1 : 0;
+        RangeResult range = ParseRange(request.Header("range"), stat.size, first, last);
+        if (range == RangeResult::Unsatisfiable) {
+            return SendError(sock, 416, "Range Not Satisfiable", keepAlive, { "Content-Range: bytes */" + std::to_string(stat.size) });
+        }
+        // Stored data goes out as it is: .zst inputs and uncompressed files
+        // always, zstd streams to clients that take them.
+        const bool stored = entry.method == acf::CompressionMethod::ZstdPassthrough ||
+                            entry.method == acf::CompressionMethod::Uncompressed;
+        const bool encoded = !stored && range == RangeResult::None &&
+                             AcceptsZstd(request.Header("accept-encoding")) && StoredFrameServable(entry);
+
+        char etag[40];
+        snprintf(etag, sizeof(etag), "\"%08x-%llx%s\"", entry.crc32, static_cast<unsigned long long>(stat.size), encoded ? "-zstd" : "");
+        std::vector<std::string> headers = {
+            std::string("Content-Type: ") + ContentType(path), std::string("ETag: ") + etag,
+            "Accept-Ranges: bytes", "Vary: Accept-Encoding",
+        };
+        if (request.Header("if-none-match") == etag) {
+            return SendHead(sock, 304, "Not Modified", headers, keepAlive);
+        }
+
+        if (stored || encoded) {
+            uint64_t offset = entry.dataOffset, length = entry.compressedSize;
+            int status = 200;
+            if (range == RangeResult::Satisfiable) {
+                offset += first;
+                length = last - first + 1;
+                status = 206;
+                headers.push_back("Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(stat.size));
+            }
+            if (encoded) headers.push_back("Content-Encoding: zstd");
+            headers.push_back("Content-Length: " + std::to_string(length));
+            if (!SendHead(sock, status, status == 206 ? "Partial Content" : "OK", headers, keepAlive)) return false;
+            return head || SendFileRange(sock, m_ArchiveFd, offset, length);
+        }
+
+        // Decoded, block by block.
+        std::unique_ptr<acf::ArchiveFile> file;
+        try {
+            file = m_Vfs.Open(path);
+        } catch (const std::exception& e) {
+            std::cerr << "acfserve: " << path << ": " << e.what() << std::endl;
+            return SendError(sock, 500, "Internal Server Error", keepAlive);
+        }
+        int status = 200;
+        uint64_t length = stat.size;
+        if (range == RangeResult::Satisfiable) {
+            status = 206;
+            length = last - first + 1;
+            headers.push_back("Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(stat.size));
+        }
+        headers.push_back("Content-Length: " + std::to_string(length));
+        if (!SendHead(sock, status, status == 206 ? "Partial Content" : "OK", headers, keepAlive)) return false;
+        if (head) return true;
+
+        std::vector<char> buffer(kSendChunk);
+        for (uint64_t pos = first, end = first + length; pos < end;) {
+            size_t n;
+            try {
+                n = file->Read(pos, buffer.data(), static_cast<size_t>(std::min<uint64_t>(buffer.size(), end - pos)));
+            } catch (const std::exception& e) {
+                // Headers are out; all that is left is to cut the response short.
+                std::cerr << "acfserve: " << path << ": " << e.what() << std::endl;
+                return false;
+            }
+            if (n == 0 || !SendAll(sock, buffer.data(), n)) return false;
+            pos += n;
+        }
+        return true;
+    }
+
+    acf::ArchiveVfs m_Vfs;
+    int m_ArchiveFd = -1;
+};
+
+// Bounds the connections served at once; accepting waits for a free slot,
+// so further clients queue in the listen backlog instead of taking threads.
+class ConnectionSlots
+{
+public:
+    explicit ConnectionSlots(size_t max) : m_Free(max) {}
+
+    void Acquire() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Released.wait(lock, [this] { return m_Free > 0; });
+        --m_Free;
+    }
+
+    void Release() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            ++m_Free;
+        }
+        m_Released.notify_one();
+    }
+
+private:
+    std::mutex m_Mutex;
+    std::condition_variable m_Released;
+    size_t m_Free;
+};
+
+int Listen(const std::string& host, const std::string& port) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        throw std::runtime_error("Could not resolve listen address: " + host);
+    }
+    int sock = -1;
+    for (addrinfo* ai = addresses; ai && sock < 0; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (sock < 0) continue;
+        int one = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(sock, ai->ai_addr, ai->ai_addrlen) != 0 || listen(sock, SOMAXCONN) != 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (sock < 0) throw std::runtime_error("Could not listen on " + host + ":" + port + ": " + strerror(errno));
+    return sock;
+}
+
+void PrintUsage() {
+    std::cout << "Usage: acfserve [options] <archive.acf>" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --bind=ADDR --port=N                       : Listen address (127.0.0.1) and port (8080)." << std::endl;
+    std::cout << "  --cache-mb=N                               : Decoded block cache for uncompressed responses (256)." << std::endl;
+    std::cout << "  --max-connections=N                        : Connections served at once; others wait to be accepted (64)." << std::endl;
+    std::cout << "  --timeout=S                                : Close connections idle or stalled for S seconds (30)." << std::endl;
+    std::cout << "  --base=<previous.acf>                      : Base of a delta archive, if not next to it under its recorded name." << std::endl;
+    std::cout << "  --repo=<dir>                               : Chunk repository of a manifest, if moved from its recorded path." << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    acf::ArchiveReaderOptions options;
+    std::string host = "127.0.0.1", port = "8080";
+    size_t cacheMB = kDefaultCacheMB, maxConnections = kDefaultMaxConnections;
+    int timeoutSeconds = kDefaultTimeout;
+    std::vector<std::string> args;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            std::string name = arg.substr(0, arg.find('='));
+            std::string value = arg.find('=') != std::string::npos ? arg.substr(arg.find('=') + 1) : "";
+            if (name == "--bind") host = value;
+            else if (name == "--port") port = value;
+            else if (name == "--cache-mb") cacheMB = std::stoull(value);
+            else if (name == "--max-connections") maxConnections = std::max<size_t>(1, std::stoull(value));
+            else if (name == "--timeout") timeoutSeconds = std::max(1, std::stoi(value));
+            else if (name == "--base") options.basePath = value;
+            else if (name == "--repo") options.repositoryPath = value;
+            else if (name == "--help" || name == "-h") { PrintUsage(); return 0; }
+            else args.push_back(arg);
+        }
+        if (args.size() != 1) {
+            PrintUsage();
+            return 1;
+        }
+        if (cacheMB) options.cache = std::make_shared<acf::BlockCache>(cacheMB << 20);
+
+        Server server(args[0], options);
+        int listener = Listen(host, port);
+        signal(SIGPIPE, SIG_IGN); // sendfile() has no MSG_NOSIGNAL
+        std::cout << "Serving " << args[0] << " on http://" << host << ":" << port << "/" << std::endl;
+        ConnectionSlots slots(maxConnections);
+        for (;;) {
+            slots.Acquire();
+            int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) {
+                slots.Release();
+                if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) continue;
+                throw std::runtime_error(std::string("accept: ") + strerror(errno));
+            }
+            // An idle keep-alive client, or one that stops in the middle of a
+            // request or response, gives its slot back after the timeout.
+            timeval timeout{ timeoutSeconds, 0 };
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            std::thread([&server, &slots, client] {
+                server.Serve(client);
+                slots.Release();
+            }).detach();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,159 @@
+#include "acf.hh"
+#include "acfinternal.hh"
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+namespace {
+
+// Tree key of a path: '/' separated, no leading or trailing '/'; "" is the root.
+// Keys with a ".." component name nothing (see detail::IsSafeInternalPath).
+std::string TreeKey(std::string path) {
+    std::replace(path.begin(), path.end(), '\\', '/');
+    size_t first = path.find_first_not_of('/');
+    if (first == std::string::npos) return std::string();
+    size_t last = path.find_last_not_of('/');
+    return path.substr(first, last - first + 1);
+}
+
+std::string ParentKey(const std::string& key) {
+    size_t slash = key.rfind('/');
+    return slash == std::string::npos ? std::string() : key.substr(0, slash);
+}
+
+} // namespace
+
+namespace acf
+{
+  class ArchiveVfs::Impl
+  {
+  public:
+    struct Node
+    {
+      std::string name;
+      VfsStat stat;
+      std::string entryPath;        // Path of the stored entry, empty for implied directories
+      std::vector<size_t> children;
+    };
+
+    explicit Impl(std::shared_ptr<const ArchiveReader> archiveReader);
+
+    const Node* Find(const std::string& path) const {
+        auto it = byKey.find(TreeKey(path));
+        return it != byKey.end() ? &nodes[it->second] : nullptr;
+    }
+
+    std::shared_ptr<const ArchiveReader> reader;
+    std::vector<Node> nodes;
+    std::unordered_map<std::string, size_t> byKey;
+
+  private:
+    // Node of a directory, created with its parents if no entry named it yet.
+    size_t Directory(const std::string& key);
+  };
+
+  ArchiveVfs::Impl::Impl(std::shared_ptr<const ArchiveReader> archiveReader)
+      : reader(std::move(archiveReader))
+  {
+    nodes.emplace_back();
+    nodes[0].stat.directory = true;
+    byKey.emplace(std::string(), 0);
+
+    for (const auto& [entry, entryPath] : reader->Entries()) {
+        const std::string key = TreeKey(entryPath);
+        if (key.empty() || !detail::IsSafeInternalPath(key)) continue;
+
+        size_t node;
+        if (entry.type == EntryType::Directory) {
+            node = Directory(key);
+            if (!nodes[node].entryPath.empty()) continue;
+        } else {
+            if (byKey.count(key)) continue;
+            const size_t parent = Directory(ParentKey(key));
+            node = nodes.size();
+            nodes.emplace_back();
+            nodes[node].name = key.substr(key.rfind('/') + 1);
+            nodes[node].stat.size = entry.method == CompressionMethod::ZstdPassthrough ? entry.compressedSize : entry.originalSize;
+            nodes[parent].children.push_back(node);
+            byKey.emplace(key, node);
+        }
+        VfsStat& stat = nodes[node].stat;
+        stat.filedatetime = entry.filedatetime;
+        stat.fileattribute = entry.fileattribute;
+        stat.unixMode = entry.unixMode;
+        nodes[node].entryPath = entryPath;
+    }
+
+    for (auto& node : nodes) {
+        std::sort(node.children.begin(), node.children.end(),
+                  [this](size_t a, size_t b) { return nodes[a].name < nodes[b].name; });
+    }
+  }
+
+  size_t ArchiveVfs::Impl::Directory(const std::string& key)
+  {
+    auto it = byKey.find(key);
+    if (it != byKey.end()) {
+        if (!nodes[it->second].stat.directory) {
+            throw std::runtime_error("Archive stores both a file and a directory at: " + key);
+        }
+        return it->second;
+    }
+    const size_t parent = Directory(ParentKey(key));
+    const size_t node = nodes.size();
+    nodes.emplace_back();
+    nodes[node].name = key.substr(key.rfind('/') + 1);
+    nodes[node].stat.directory = true;
+    nodes[parent].children.push_back(node);
+    byKey.emplace(key, node);
+    return node;
+  }
+
+  ArchiveVfs::ArchiveVfs(std::shared_ptr<const ArchiveReader> reader)
+      : m_Impl(std::make_unique<Impl>(std::move(reader))) {}
+
+  ArchiveVfs::~ArchiveVfs() {}
+
+  const ArchiveReader& ArchiveVfs::Reader() const {
+    return *m_Impl->reader;
+  }
+
+  bool ArchiveVfs::Stat(const std::string& path, VfsStat& stat) const {
+    const Impl::Node* node = m_Impl->Find(path);
+    if (!node) return false;
+    stat = node->stat;
+    return true;
+  }
+
+  const ACFEntryData* ArchiveVfs::Find(const std::string& path) const {
+    const Impl::Node* node = m_Impl->Find(path);
+    return node && !node->entryPath.empty() ? m_Impl->reader->Find(node->entryPath) : nullptr;
+  }
+
+  std::unique_ptr<ArchiveFile> ArchiveVfs::Open(const std::string& path) const {
+    const Impl::Node* node = m_Impl->Find(path);
+    if (!node) {
+        throw std::runtime_error("File not found in archive: " + path);
+    }
+    if (node->stat.directory) {
+        throw std::runtime_error("Cannot open a directory: " + path);
+    }
+    return m_Impl->reader->Open(node->entryPath);
+  }
+
+  std::vector<VfsDirEntry> ArchiveVfs::ReadDir(const std::string& path) const {
+    const Impl::Node* node = m_Impl->Find(path);
+    if (!node || !node->stat.directory) {
+        throw std::runtime_error("Directory not found in archive: " + path);
+    }
+    std::vector<VfsDirEntry> listing;
+    listing.reserve(node->children.size());
+    for (size_t child : node->children) {
+        listing.push_back({m_Impl->nodes[child].name, m_Impl->nodes[child].stat});
+    }
+    return listing;
+  }
+
+} // namespace acf
@@ -7,6 +7,7 @@
 #include <memory>
 #include <filesystem>
 #include <fstream>
+#include <algorithm>
 
 // --- Global State Management ---
 struct ArchiveState {
@@ -29,6 +30,11 @@ namespace {
         LocalFileTimeToFileTime(&lft, &ft); // Convert to UTC for setting
         return ft;
     }
+
+    // Bytes ProcessFileW writes for the entry: stored .zst inputs are extracted as stored.
+    uint64_t ExtractedSize(const acf::ACFEntryData& entry) {
+        return entry.method == acf::CompressionMethod::ZstdPassthrough ? entry.compressedSize : entry.originalSize;
+    }
 } // namespace
 
 // --- DLL Entry Point ---
@@ -80,9 +86,10 @@ extern "C" __declspec(dllexport) int __stdcall ReadHeaderExW(HANDLE hArcData, tH
 
     memset(HeaderData, 0, sizeof(tHeaderDataExW));
     std::wstring wpath = StringToWString(path);
+    std::replace(wpath.begin(), wpath.end(), L'/', L'\\'); // Total Commander expects native separators
     wcsncpy_s(HeaderData->FileName, wpath.c_str(), _TRUNCATE);
 
-    HeaderData->UnpSize = entry.originalSize;
+    HeaderData->UnpSize = ExtractedSize(entry);
     HeaderData->PackSize = entry.compressedSize;
     HeaderData->FileCRC = entry.crc32;
     HeaderData->FileTime = entry.filedatetime;
@@ -129,7 +136,7 @@ extern "C" __declspec(dllexport) int __stdcall ProcessFileW(HANDLE hArcData, int
         SetFileAttributesW(finalDestPath.c_str(), entry.fileattribute);
 
         if (state->processDataProc) {
-            state->processDataProc((WCHAR*)finalDestPath.c_str(), entry.originalSize);
+            state->processDataProc((WCHAR*)finalDestPath.c_str(), ExtractedSize(entry));
         }
     } catch (...) {
         return E_EWRITE;
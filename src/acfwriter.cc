@@ -0,0 +1,143 @@
+#include "acf.hh"
+#include "acfinternal.hh"
+#include <stdexcept>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <unordered_set>
+#include <cstring>
+
+namespace acf
+{
+  class ArchiveWriter::Impl
+  {
+  public:
+    explicit Impl(const std::string& archivePath);
+    void Add(const ACFEntryData& entry, const std::string& path);
+    void Close();
+
+    std::string path;
+    std::ofstream file;
+    uint64_t offset = sizeof(ACFHeader);  // Where the next frame goes
+    bool closed = false;
+
+  private:
+    std::vector<ACFEntryData> m_Entries;
+    std::vector<std::string> m_Paths;
+    std::unordered_set<std::string> m_Seen;
+  };
+
+  ArchiveWriter::Impl::Impl(const std::string& archivePath)
+      : path(archivePath), file(archivePath, std::ios::binary | std::ios::trunc)
+  {
+    if (!file) {
+        throw std::runtime_error("Could not create archive file: " + archivePath);
+    }
+    ACFHeader header;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(ACFHeader)); // Placeholder
+  }
+
+  void ArchiveWriter::Impl::Add(const ACFEntryData& entry, const std::string& entryPath)
+  {
+    if (closed) {
+        throw std::runtime_error("Archive already closed: " + path);
+    }
+    if (entryPath.empty() || entryPath.size() > UINT16_MAX) {
+        throw std::runtime_error("Invalid path for archive entry: " + entryPath);
+    }
+    if (!m_Seen.insert(entryPath).second) {
+        throw std::runtime_error("Duplicate path in archive: " + entryPath);
+    }
+    m_Entries.push_back(entry);
+    m_Entries.back().pathLength = static_cast<uint16_t>(entryPath.size());
+    m_Paths.push_back(entryPath);
+  }
+
+  void ArchiveWriter::Impl::Close()
+  {
+    if (closed) return;
+    closed = true;
+    ACFHeader header;
+    header.centralDirOffset = offset;
+    header.entryCount = m_Entries.size();
+    header.entrySize = sizeof(ACFEntryData);
+
+    std::vector<char> centralDirBuffer;
+    for (size_t i = 0; i < m_Entries.size(); ++i) {
+        const char* entry_ptr = reinterpret_cast<const char*>(&m_Entries[i]);
+        centralDirBuffer.insert(centralDirBuffer.end(), entry_ptr, entry_ptr + sizeof(ACFEntryData));
+        centralDirBuffer.insert(centralDirBuffer.end(), m_Paths[i].begin(), m_Paths[i].end());
+    }
+    file.write(centralDirBuffer.data(), centralDirBuffer.size());
+    header.centralDirCRC32 = detail::Crc32Update(0, centralDirBuffer.data(), centralDirBuffer.size());
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(ACFHeader));
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Could not write archive file: " + path);
+    }
+  }
+
+  ArchiveWriter::ArchiveWriter(const std::string& archivePath)
+      : m_Impl(std::make_unique<Impl>(archivePath)) {}
+
+  ArchiveWriter::~ArchiveWriter() {
+    try {
+        m_Impl->Close();
+    } catch (const std::exception&) {
+    }
+  }
+
+  void ArchiveWriter::AddDirectory(const std::string& path, uint32_t filedatetime, uint8_t fileattribute, uint32_t unixMode) {
+    std::string internalPath = detail::NormalizeInternalPath(path);
+    if (!internalPath.empty() && internalPath.back() != '/') internalPath += '/';
+
+    ACFEntryData entry{};
+    entry.type = EntryType::Directory;
+    entry.filedatetime = filedatetime;
+    entry.fileattribute = fileattribute;
+    entry.unixMode = unixMode;
+    m_Impl->Add(entry, internalPath);
+  }
+
+  void ArchiveWriter::AddRawFrame(const std::string& path, const StoredFrame& frame) {
+    if (frame.method != CompressionMethod::Zstd && frame.method != CompressionMethod::ZstdPassthrough) {
+        throw std::runtime_error("Only self-contained zstd frames can be added: " + path);
+    }
+    if (frame.data.size() != frame.compressedSize) {
+        throw std::runtime_error("Frame size does not match its recorded size: " + path);
+    }
+    uint32_t magic = 0;
+    if (frame.data.size() >= sizeof(magic)) memcpy(&magic, frame.data.data(), sizeof(magic));
+    if (magic != ZSTD_MAGICNUMBER) {
+        throw std::runtime_error("Data does not start with a zstd frame: " + path);
+    }
+
+    ACFEntryData entry{};
+    entry.type = EntryType::File;
+    entry.originalSize = frame.originalSize;
+    entry.compressedSize = frame.compressedSize;
+    entry.dataOffset = m_Impl->offset;
+    entry.crc32 = frame.crc32;
+    entry.filedatetime = frame.filedatetime;
+    entry.fileattribute = frame.fileattribute;
+    entry.unixMode = frame.unixMode;
+    entry.windowLog = frame.windowLog;
+    entry.method = frame.method;
+    entry.filter = frame.filter;
+    entry.filterParam = frame.filterParam;
+    m_Impl->Add(entry, detail::NormalizeInternalPath(path));
+
+    m_Impl->file.write(reinterpret_cast<const char*>(frame.data.data()), frame.data.size());
+    if (!m_Impl->file) {
+        throw std::runtime_error("Could not write archive file: " + m_Impl->path);
+    }
+    m_Impl->offset += frame.data.size();
+  }
+
+  void ArchiveWriter::Close() {
+    m_Impl->Close();
+  }
+
+} // namespace acf